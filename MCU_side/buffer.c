@@ -1,3 +1,4 @@
+#include <string.h>
 #include "buffer.h"
 
 //Size of buffer
@@ -39,3 +40,34 @@ uint8_t buffer_space(struct Buffer *buff)
         return BUFF_NOT_FULL;
 }
 
+
+uint8_t buffer_free(struct Buffer *buff)
+{
+    //number of bytes that can be added before the buffer is full
+    return (buff->front + BUFFER_SIZE - buff->rear - 1) % BUFFER_SIZE;
+}
+
+uint8_t buffer_count(struct Buffer *buff)
+{
+    //number of bytes waiting to be read
+    return (buff->rear + BUFFER_SIZE - buff->front) % BUFFER_SIZE;
+}
+
+void buffer_read(struct Buffer *buff, uint8_t *data, uint8_t len)
+{
+    //copies len bytes out in at most two runs, the caller checks buffer_count() first
+    uint8_t start = (buff->front + 1) % BUFFER_SIZE;
+    uint8_t first = BUFFER_SIZE - start;
+
+    if(first > len)
+        first = len;
+    memcpy(data, &buff->arr[start], first);
+    memcpy(&data[first], buff->arr, len - first);
+    buff->front = (buff->front + len) % BUFFER_SIZE;
+}
+
+uint8_t buffer_peek(struct Buffer *buff, uint8_t offset)
+{
+    //byte offset places after the next one to be read, the caller checks buffer_count() first
+    return buff->arr[(buff->front + 1 + offset) % BUFFER_SIZE];
+}
@@ -14,5 +14,9 @@ void buffer_init(struct Buffer *buff, uint8_t *buff_name);
 void buffer_add(struct Buffer *buff, uint8_t data);
 uint8_t buffer_get(struct Buffer *buff);
 uint8_t buffer_space(struct Buffer *buff);
+uint8_t buffer_free(struct Buffer *buff);
+uint8_t buffer_count(struct Buffer *buff);
+void buffer_read(struct Buffer *buff, uint8_t *data, uint8_t len);
+uint8_t buffer_peek(struct Buffer *buff, uint8_t offset);
 
 #endif //_BUFF_H_
@@ -0,0 +1,17 @@
+#ifndef _COBS_H_
+#define _COBS_H_
+
+#include <stdint.h>
+
+//Consistent Overhead Byte Stuffing for blocks shorter than 254 bytes, table-free and in place.
+//The encoded block has no zero bytes, so a zero delimits it on the wire.
+//
+//The caller keeps buf[0] spare: encoding turns it into the first code and every zero in
+//buf[1] .. buf[len - 1] into the distance to the next zero, so nothing moves.
+
+void cobs_encode(uint8_t *buf, uint8_t len);
+//Reverses cobs_encode() on len encoded bytes starting at ring[start], indices wrap at size so it
+//runs directly on a circular buffer. Returns len, or -1 if the block is not valid COBS.
+int16_t cobs_decode_ring(uint8_t *ring, uint8_t size, uint8_t start, uint8_t len);
+
+#endif //_COBS_H_
@@ -1,12 +1,37 @@
 #include "crc16.h"
 
+#if CRC16_BACKEND == CRC16_BACKEND_NIBBLE
+//First 16 entries of crc16_table, i.e. the CCITT remainder of a single nibble
+static const uint16_t crc16_nibble_table[16] =
+{
+ 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+ 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static inline uint16_t crc16_step(uint16_t crc, uint8_t data)
+{
+    uint8_t index = data ^ (uint8_t) crc;
+    uint16_t high = crc16_nibble_table[index >> 4];
+    //the high nibble sits four bits further up, reduce the bits shifted out of the register
+    high = (high << 4) ^ crc16_nibble_table[high >> 12];
+    return high ^ crc16_nibble_table[index & 0x0F] ^ (crc >> 8);
+}
+#elif CRC16_BACKEND == CRC16_BACKEND_TABLE
+static inline uint16_t crc16_step(uint16_t crc, uint8_t data)
+{
+    return crc16_table[data ^ (uint8_t) crc] ^ (crc >> 8);
+}
+#else
+#error "Unknown CRC16_BACKEND"
+#endif
+
 uint16_t crc16_ccitt(uint8_t *data, uint8_t len)
 {
     uint16_t crc;
     crc = 0xFFFF ^ 0xFFFF;
     while (len > 0)
     {
-        crc = table[*data ^ (uint8_t) crc] ^ (crc >> 8);
+        crc = crc16_step(crc, *data);
         data++;
         len--;
     }
@@ -24,3 +49,24 @@ bool validate_message(uint8_t *crc16_Rx_bytes, uint8_t *data, uint8_t len)
     else
         return false;
 }
+
+uint16_t crc16_init(void)
+{
+    return 0xFFFF ^ 0xFFFF;
+}
+
+uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+    return crc16_step(crc, data);
+}
+
+uint16_t crc16_final(uint16_t crc)
+{
+    return crc ^ 0xFFFF;
+}
+
+bool validate_crc(uint8_t *crc16_Rx_bytes, uint16_t calculated_crc)
+{
+    uint16_t received_crc = ((crc16_Rx_bytes[1] << 8) | (crc16_Rx_bytes[0]));
+    return received_crc == calculated_crc;
+}
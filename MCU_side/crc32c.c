@@ -0,0 +1,35 @@
+#include "crc32c.h"
+
+uint32_t crc32c(uint8_t *data, uint32_t len)
+{
+    uint32_t crc = crc32c_init();
+    while (len > 0)
+    {
+        crc = crc32c_update(crc, *data);
+        data++;
+        len--;
+    }
+    return crc32c_final(crc);
+}
+
+uint32_t crc32c_init(void)
+{
+    return 0xFFFFFFFF;
+}
+
+uint32_t crc32c_update(uint32_t crc, uint8_t data)
+{
+    return crc32c_table[(crc ^ data) & 0xFF] ^ (crc >> 8);
+}
+
+uint32_t crc32c_final(uint32_t crc)
+{
+    return crc ^ 0xFFFFFFFF;
+}
+
+bool validate_crc32c(uint8_t *crc32c_Rx_bytes, uint32_t calculated_crc)
+{
+    uint32_t received_crc = ((uint32_t)crc32c_Rx_bytes[3] << 24) | ((uint32_t)crc32c_Rx_bytes[2] << 16) |
+                            ((uint32_t)crc32c_Rx_bytes[1] << 8) | (crc32c_Rx_bytes[0]);
+    return received_crc == calculated_crc;
+}
@@ -0,0 +1,19 @@
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Reflected CRC-32C (Castagnoli) table, defined once in crc32c_table.c (generated by tools/crcgen)
+extern const uint32_t crc32c_table[256];
+
+//CRC-32C check value generation, used for the trailer of data frames in INTEGRITY_CRC32C mode
+uint32_t crc32c(uint8_t *data, uint32_t len);
+
+//Streaming CRC-32C: fold bytes in as they arrive, crc32c_final() matches crc32c() over the same bytes
+uint32_t crc32c_init(void);
+uint32_t crc32c_update(uint32_t crc, uint8_t data);
+uint32_t crc32c_final(uint32_t crc);
+bool validate_crc32c(uint8_t *crc32c_Rx_bytes, uint32_t calculated_crc);
+
+#endif //_CRC32C_H_
@@ -4,9 +4,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "crc16.h"
+#include "crc32c.h"
 #include "divisible.h"
 #include "messages.h"
 #include "buffer.h"
+#include "window.h"
+#include "cobs.h"
 #include "inc/hw_gpio.h"
 #include "inc/hw_uart.h"
 #include "inc/hw_memmap.h"
@@ -17,17 +20,7 @@
 
 enum
 {
-    SEND_DATA = 1, SEND_CRC = 2, GET_DATA = 3, GET_CRC = 4,
-};
-
-enum
-{
-    STR_HEADER = 11, STR_ENDING = 12,
-};
-
-enum
-{
-    CRC_1 = 21, CRC_2 = 22
+    INTEGRITY_CRC16 = 31, INTEGRITY_CRC32C = 32
 };
 
 //buffer size 50
@@ -46,6 +39,29 @@ enum
 #define BUFF_FULL   1
 //Circular buffer NOT FULL condition
 #define BUFF_NOT_FULL   2
+//Control values outside the 0-100 user data range, they select the trailer of data frames
+#define CMD_INTEGRITY_CRC16     0xF0
+#define CMD_INTEGRITY_CRC32C    0xF1
+//Frames kept in flight towards the host, at most LINK_MAX_WINDOW
+#define LINK_TX_WINDOW  4
+//Serial line rate set up by UART_config(), 8N1 puts ten bits on the wire per byte
+#define LINK_BAUDRATE   2400
+#define LINK_BYTE_BITS  10
+//Retransmit timeout in ms. A reply can wait behind a full window of the largest frames (4 frames
+//take about 650 ms at 2400 baud) and its ACK behind as many requests from the host, plus this much
+//for the host and the USB latency. Worked out the same way as default_rto_ms() on the host.
+#define LINK_RTO_MARGIN_MS  200
+#define LINK_RTO_MS     (LINK_RTO_MARGIN_MS \
+                         + 2 * LINK_TX_WINDOW * LINK_MAX_COBS_FRAME * LINK_BYTE_BITS * 1000 / LINK_BAUDRATE)
+//Legacy host requests carry one command byte: type, seq, command, CRC16
+#define REQUEST_FRAME_LEN   5
+//Host link framing, chosen per build with -DLINK_COBS=1: zero-delimited COBS frames only.
+//Otherwise legacy and length-prefixed frames, each answered in the format it arrives in.
+#ifndef LINK_COBS
+#define LINK_COBS   0
+#endif
+//SysTick exception number, inc/hw_ints.h has it but clashes with inc/tm4c123gh6pm.h
+#define FAULT_SYSTICK   15
 
 void portF_config(void);
 void timer1A_config(void);
@@ -56,11 +72,23 @@ void uDMA_Error_Handler(void);
 void UART_init(void);
 void UART_config(void);
 void UART0_Handler(void);
+void SysTick_config(void);
+void SysTick_Handler(void);
 void send_data(uint8_t outgoing_data);
+void send_frame(uint8_t *frame, uint8_t len);
 void parse_message(void);
+void parse_cobs(void);
+void rx_crc_start(bool use_crc32c);
+void rx_crc_fold(const uint8_t *data, uint8_t len);
+uint32_t rx_crc_final(void);
+void handle_frame(uint8_t flags, uint8_t seq, uint8_t *payload, uint8_t len);
+void serve_requests(void);
+void send_pending(void);
+void run_command(void);
+uint8_t reply_code(uint8_t data);
 void select_str(void);
-void send_message(void);
 void onBoardLED(uint8_t duty_cycle);
+void led_poll(void);
 
 //1024-byte aligned channel control table
 #pragma DATA_ALIGN(uc_control_table, 1024)
@@ -69,87 +97,50 @@ uint32_t uc_control_table[256];
 struct Buffer buffRx;
 struct Buffer buffTx;
 
-bool Tx_data_flag = false;
-bool Rx_data_flag = true;
-bool data_sent = false;
-bool data_received = false;
+struct TxWindow txWin;
+struct RxWindow rxWin;
+
+//milliseconds since reset, drives the retransmit timers
+volatile uint32_t tick_ms = 0;
+bool ack_pending = false;
+//running CRC of the frame being received, folded in byte by byte so the end-of-frame check is one compare
+uint16_t rx_crc16;
+uint32_t rx_crc32c;
+bool rx_crc32c_mode = false;
+bool led_on = false;
 
 uint8_t user_data; //duty cycle - from user
 uint8_t Rx_buffer[BUFFER_SIZE];
 uint8_t Tx_buffer[BUFFER_SIZE];
-uint8_t crc16_Tx_bytes[2];
-uint8_t crc16_Rx_bytes[2];
+uint8_t integrity_mode = INTEGRITY_CRC16;
+//format of the last valid frame from the host, replies and ACKs use the same one
+uint8_t link_framing = LINK_COBS ? LINK_FRAMING_COBS : LINK_FRAMING_LEGACY;
 char send_str[STR_SIZE];
-uint8_t feedback_status = 0;
 
 int main(void)
 {
     buffer_init(&buffRx, Rx_buffer);
     buffer_init(&buffTx, Tx_buffer);
+    tx_window_init(&txWin, LINK_TX_WINDOW);
+    rx_window_init(&rxWin);
 
     portF_config();
     timer1A_config();
     timer0B_config();
+    SysTick_config();
     UART_init();
     UART_config();
 
     IntMasterEnable();
 
+    //Requests and replies both run through a selective-repeat window: the host keeps several
+    //requests in flight and replies go out without waiting for the previous one to be acknowledged
     while(1)
     {
-        if(Rx_data_flag)
-        {
-            if(!data_received)
-                parse_message();
-
-            if(data_received)
-            {
-                if(validate_message(crc16_Rx_bytes, &user_data, 1))
-                {
-                    Rx_data_flag = false;
-                    Tx_data_flag = true;
-                    feedback_status = 1;
-                    send_data(feedback_status);
-
-                    select_str();
-                    uint16_t Tx_crc16 = crc16_ccitt((uint8_t *)send_str, strlen(send_str)+1);
-                    crc16_Tx_bytes[0] = (Tx_crc16 & 0xFF);
-                    crc16_Tx_bytes[1] = ((Tx_crc16 >> 8) & 0xFF);
-                }
-                else
-                {
-                    feedback_status = 0;
-                    send_data(feedback_status);
-                }
-                data_received = false;
-            }
-        }
-        else if(Tx_data_flag)
-        {
-            if (!data_sent)
-                send_message();
-
-            if(data_sent)
-            {
-                if (buffer_space(&buffRx) != BUFF_EMPTY)
-                {
-                    feedback_status = buffer_get(&buffRx);
-                    if (feedback_status == 1)
-                    {
-                        Tx_data_flag = false;
-                        Rx_data_flag = true;
-                        feedback_status = 0;
-                        data_sent = false;
-
-                        onBoardLED(100 - user_data);
-                    }
-                    else
-                    {
-                        data_sent = false;
-                    }
-                }
-            }
-        }
+        parse_message();
+        serve_requests();
+        send_pending();
+        led_poll();
     }
 }
 
@@ -377,127 +368,325 @@ void timer0B_config(void)
     TIMER0_TBPR_R = 0xFF;
 }
 
+void SysTick_config(void)
+{
+    //SysTick disabled while it is set up
+    NVIC_ST_CTRL_R = 0;
+    //1 ms period: 16,000,000 / 1000 cycles
+    NVIC_ST_RELOAD_R = (CLK_FREQ / 1000) - 1;
+    NVIC_ST_CURRENT_R = 0;
+    //Registers a function to be called on every SysTick expiry
+    IntRegister(FAULT_SYSTICK, SysTick_Handler);
+    //System clock source, interrupt enabled, counter enabled
+    NVIC_ST_CTRL_R = (1 << 2) | (1 << 1) | (1 << 0);
+}
+
+void SysTick_Handler(void)
+{
+    tick_ms++;
+}
+
 void parse_message(void)
 {
-    static uint8_t msg_parse_state = GET_DATA;
-    static uint8_t crc_state = CRC_1;
+    static uint8_t frame[LINK_MAX_FRAME];
+    static uint8_t frame_index = 0;
+    static uint8_t frame_len = 0;
 
-    if(buffer_space(&buffRx) != BUFF_EMPTY)
+    if(link_framing == LINK_FRAMING_COBS)
     {
-        switch (msg_parse_state)
+        parse_cobs();
+        return;
+    }
+
+    while(buffer_space(&buffRx) != BUFF_EMPTY)
+    {
+        //once the header of a length-prefixed frame is in, the rest comes out in one read
+        if(frame_index == LINK_HEADER_LEN && frame[0] == LINK_SOF)
         {
-            case GET_DATA:
+            if(buffer_count(&buffRx) < frame_len - frame_index)
+                return;
+            buffer_read(&buffRx, &frame[frame_index], frame_len - frame_index);
+            //the payload joins the running CRC as it comes off the ring, the trailer does not
+            rx_crc_fold(&frame[frame_index], frame[3]);
+            frame_index = 0;
+            if(link_check_framed(frame, rx_crc_final()))
             {
-                user_data = buffer_get(&buffRx);
-                msg_parse_state = GET_CRC;
+                link_framing = LINK_FRAMING_LENGTH;
+                handle_frame(frame[1], frame[2], &frame[LINK_HEADER_LEN], frame[3]);
             }
-            break;
-            case GET_CRC:
+            continue;
+        }
+
+        uint8_t incoming_data = buffer_get(&buffRx);
+
+        //a frame starts with its marker or type byte, anything else is the rest of a damaged frame
+        if(frame_index == 0)
+        {
+            if(incoming_data == LINK_SOF)
+                frame_len = LINK_HEADER_LEN;
+            else if(incoming_data == LINK_DATA16 || incoming_data == LINK_ACK)
+                frame_len = REQUEST_FRAME_LEN;
+            else
+                continue;
+            //a legacy frame is CRC16 from its type byte on
+            if(incoming_data != LINK_SOF)
+                rx_crc_start(false);
+        }
+        //the CRC of a length-prefixed frame starts at its flags byte, which also picks the trailer
+        else if(frame_index == 1 && frame[0] == LINK_SOF)
+        {
+            rx_crc_start(incoming_data & LINK_FLAG_CRC32C);
+        }
+
+        frame[frame_index] = incoming_data;
+        frame_index++;
+        //flags to the end of the header, or a legacy frame up to its trailer at byte 3
+        if((frame[0] == LINK_SOF) ? (frame_index > 1) : (frame_index <= 3))
+            rx_crc_fold(&incoming_data, 1);
+        if(frame_index < frame_len)
+            continue;
+
+        if(frame[0] == LINK_SOF)
+        {
+            //header complete, the len field gives the size of the whole frame
+            frame_len = link_framed_len(frame);
+            if(frame_len == 0)
+                frame_index = 0;
+        }
+        else
+        {
+            //legacy requests and ACKs are both 5 bytes, CRC16 over the first three
+            frame_index = 0;
+            if(validate_crc(&frame[3], rx_crc_final()))
             {
-                switch (crc_state)
-                {
-                    case CRC_1:
-                    {
-                        crc16_Rx_bytes[0] = buffer_get(&buffRx);
-                        crc_state = CRC_2;
-                    }
-                    break;
-                    case CRC_2:
-                    {
-                        crc16_Rx_bytes[1] = buffer_get(&buffRx);
-                        crc_state = CRC_1;
-                        msg_parse_state = GET_DATA;
-                        data_received = true;
-                    }
-                    break;
-                }
+                link_framing = LINK_FRAMING_LEGACY;
+                handle_frame((frame[0] == LINK_ACK) ? LINK_FLAG_ACK : 0, frame[1], &frame[2], 1);
             }
-            break;
         }
     }
 }
 
-void select_str(void)
+void parse_cobs(void)
 {
-    if(divisible(user_data, div1) && divisible(user_data, div2))
-        memcpy(send_str, str3, sizeof(str3));
-    else
+    static uint8_t frame[LINK_MAX_COBS_FRAME];
+    static uint8_t scan = 0;
+    static bool discard = false;
+
+    //look for the delimiter without taking bytes out, the frame is decoded where it lies in buffRx
+    while(scan < buffer_count(&buffRx))
     {
-        if(divisible(user_data, div1))
-            memcpy(send_str, str1, sizeof(str1));
-        else if(divisible(user_data, div2))
-            memcpy(send_str, str2, sizeof(str2));
+        if(buffer_peek(&buffRx, scan) != LINK_COBS_DELIMITER)
+        {
+            scan++;
+            //longer than any frame, drop it and wait for the next delimiter
+            if(scan == LINK_MAX_COBS_FRAME)
+            {
+                buffer_read(&buffRx, frame, scan);
+                scan = 0;
+                discard = true;
+            }
+            continue;
+        }
+
+        if(!discard && scan > 0
+           && cobs_decode_ring(buffRx.arr, BUFFER_SIZE, (buffRx.front + 1) % BUFFER_SIZE, scan) > 0)
+        {
+            buffer_read(&buffRx, frame, scan);
+            if(link_check_cobs(frame, scan))
+                handle_frame(frame[1], frame[2], &frame[LINK_HEADER_LEN], frame[3]);
+        }
         else
-            sprintf(send_str, "%u", user_data);
+        {
+            buffer_read(&buffRx, frame, scan);
+        }
+        buffer_get(&buffRx);    //the delimiter
+        scan = 0;
+        discard = false;
     }
 }
 
-void send_message(void)
+void rx_crc_start(bool use_crc32c)
 {
-    static uint8_t msg_send_state = SEND_DATA;
-    static uint8_t tx_str_state = STR_HEADER;
-    static uint8_t crc_state = CRC_1;
-    static uint8_t str_index = 0;
+    rx_crc32c_mode = use_crc32c;
+    rx_crc16 = crc16_init();
+    rx_crc32c = crc32c_init();
+}
 
-    if(buffer_space(&buffTx) != BUFF_FULL)
+void rx_crc_fold(const uint8_t *data, uint8_t len)
+{
+    uint8_t index;
+
+    for(index = 0; index < len; index++)
     {
-        switch(msg_send_state)
+        if(rx_crc32c_mode)
+            rx_crc32c = crc32c_update(rx_crc32c, data[index]);
+        else
+            rx_crc16 = crc16_update(rx_crc16, data[index]);
+    }
+}
+
+uint32_t rx_crc_final(void)
+{
+    return rx_crc32c_mode ? crc32c_final(rx_crc32c) : crc16_final(rx_crc16);
+}
+
+void handle_frame(uint8_t flags, uint8_t seq, uint8_t *payload, uint8_t len)
+{
+    if(flags & LINK_FLAG_ACK)
+    {
+        //seq is cum, the payload is the sack bitmap. An ACK without it would apply whatever byte
+        //is left in the frame buffer and mark frames as received that were not.
+        if(len == 1)
+            tx_window_ack(&txWin, seq, payload[0]);
+    }
+    else
+    {
+        //every request is answered with an ACK, duplicates too in case the last ACK was lost
+        rx_window_accept(&rxWin, seq, flags & (LINK_FLAG_BATCH | LINK_FLAG_TAGGED), payload, len);
+        ack_pending = true;
+    }
+}
+
+void serve_requests(void)
+{
+    uint8_t request[LINK_MAX_PAYLOAD];
+    uint8_t flags;
+    int16_t len;
+    uint8_t start;
+    uint8_t index;
+
+    //The receive window is the command queue: requests are acknowledged as they arrive and wait
+    //there, up to LINK_MAX_WINDOW frames, until their reply fits in the transmit window
+    while(!tx_window_full(&txWin) && (len = rx_window_deliver(&rxWin, request, &flags)) > 0)
+    {
+        //a tagged request starts with its ID, the reply starts with the same ID so the host can
+        //match it with the request whatever order replies come back in
+        start = (flags & LINK_FLAG_TAGGED) ? 1 : 0;
+
+        if(flags & LINK_FLAG_BATCH)
         {
-            case SEND_DATA:
+            //commands run in order, the reply has one code per command in place of the strings
+            for(index = start; index < len; index++)
             {
-                uint8_t outgoing_data;
-                switch(tx_str_state)
-                {
-                    case STR_HEADER:
-                    {
-                        outgoing_data = send_str[str_index];
-                        send_data(outgoing_data);
-                        str_index++;
-                        tx_str_state = STR_ENDING;
-                    }
-                    break;
-                    case STR_ENDING:
-                    {
-                        outgoing_data = send_str[str_index];
-                        if(outgoing_data == '\0')
-                        {
-                            send_data(outgoing_data);
-                            tx_str_state = STR_HEADER;
-                            msg_send_state = SEND_CRC;
-                            str_index = 0;
-                        }
-                        else
-                        {
-                            send_data(outgoing_data);
-                            str_index++;
-                        }
-                    }
-                    break;
-                }
+                user_data = request[index];
+                run_command();
+                request[index] = reply_code(user_data);
             }
+        }
+        else if(len > start)
+        {
+            user_data = request[start];
+            select_str();
+            run_command();
+
+            //the ID stays in front of the string, length-prefixed replies do not need the NUL
+            len = start + strlen(send_str) + (link_framing == LINK_FRAMING_LEGACY);
+            memcpy(&request[start], send_str, len - start);
+        }
+        else
+        {
+            continue;
+        }
+
+        //a CRC-32C command applies to its own reply already
+        if(integrity_mode == INTEGRITY_CRC32C)
+            flags |= LINK_FLAG_CRC32C;
+        tx_window_push(&txWin, flags, request, len);
+    }
+}
+
+void run_command(void)
+{
+    //the trailer type is in every frame header, so the mode switches right away
+    if(user_data == CMD_INTEGRITY_CRC16)
+        integrity_mode = INTEGRITY_CRC16;
+    else if(user_data == CMD_INTEGRITY_CRC32C)
+        integrity_mode = INTEGRITY_CRC32C;
+    else
+        onBoardLED(100 - user_data);
+}
+
+void send_pending(void)
+{
+    uint8_t frame[LINK_MAX_COBS_FRAME];
+    uint8_t frame_len;
+    int16_t seq;
+
+    //ACKs go first, they are short and release the host's window
+    if(ack_pending)
+    {
+        uint8_t cum, sack;
+        rx_window_ack_fields(&rxWin, &cum, &sack);
+        if(link_framing == LINK_FRAMING_LEGACY)
+            frame_len = link_build_ack(frame, cum, sack);
+        else
+            frame_len = link_build_framed_ack(frame, cum, sack);
+        if(link_framing == LINK_FRAMING_COBS)
+            frame_len = link_cobs_wrap(frame, frame_len);
+        if(buffer_free(&buffTx) >= frame_len)
+        {
+            send_frame(frame, frame_len);
+            ack_pending = false;
+        }
+    }
+
+    //one new or timed out reply per pass, once the whole frame fits in the Tx buffer
+    seq = tx_window_due(&txWin, tick_ms, LINK_RTO_MS);
+    if(seq >= 0)
+    {
+        struct TxSlot *slot = &txWin.slot[seq % LINK_MAX_WINDOW];
+        if(link_framing == LINK_FRAMING_LEGACY)
+            frame_len = link_build_data(frame, slot->flags, seq, slot->payload, slot->len);
+        else
+            frame_len = link_build_framed_data(frame, slot->flags, seq, slot->payload, slot->len);
+        if(link_framing == LINK_FRAMING_COBS)
+            frame_len = link_cobs_wrap(frame, frame_len);
+        if(buffer_free(&buffTx) >= frame_len)
+        {
+            send_frame(frame, frame_len);
+            tx_window_sent(&txWin, seq, tick_ms);
+        }
+    }
+}
+
+uint8_t reply_code(uint8_t data)
+{
+    if(data == CMD_INTEGRITY_CRC16)
+        return REPLY_CRC16;
+    else if(data == CMD_INTEGRITY_CRC32C)
+        return REPLY_CRC32C;
+    else if(divisible(data, div1) && divisible(data, div2))
+        return REPLY_STR3;
+    else if(divisible(data, div1))
+        return REPLY_STR1;
+    else if(divisible(data, div2))
+        return REPLY_STR2;
+    else
+        return REPLY_VALUE;
+}
+
+void select_str(void)
+{
+    switch(reply_code(user_data))
+    {
+        case REPLY_CRC16:
+            memcpy(send_str, str_crc16, sizeof(str_crc16));
             break;
-            case SEND_CRC:
-            {
-                switch (crc_state)
-                {
-                    case CRC_1:
-                    {
-                        send_data(crc16_Tx_bytes[0]);
-                        crc_state = CRC_2;
-                    }
-                    break;
-                    case CRC_2:
-                    {
-                        send_data(crc16_Tx_bytes[1]);
-                        crc_state = CRC_1;
-                        msg_send_state = SEND_DATA;
-                        data_sent = true;
-                    }
-                    break;
-                }
-            }
+        case REPLY_CRC32C:
+            memcpy(send_str, str_crc32c, sizeof(str_crc32c));
+            break;
+        case REPLY_STR3:
+            memcpy(send_str, str3, sizeof(str3));
+            break;
+        case REPLY_STR1:
+            memcpy(send_str, str1, sizeof(str1));
+            break;
+        case REPLY_STR2:
+            memcpy(send_str, str2, sizeof(str2));
+            break;
+        default:
+            sprintf(send_str, "%u", user_data);
             break;
-        }
     }
 }
 
@@ -525,6 +714,14 @@ void send_data(uint8_t outgoing_data)
     }
 }
 
+void send_frame(uint8_t *frame, uint8_t len)
+{
+    uint8_t index;
+
+    for(index = 0; index < len; index++)
+        send_data(frame[index]);
+}
+
 void onBoardLED(uint8_t duty_cycle_complement)
 {
     GPIO_PORTF_DIR_R &= ~(0x02);
@@ -546,11 +743,19 @@ void onBoardLED(uint8_t duty_cycle_complement)
 
     //Timer 0B enabled
     TIMER0_CTL_R |= (0x01 << 8);
+    //(Re)start the PERIOD long Timer 1A, led_poll() turns the LED off when it expires
+    TIMER1_CTL_R &= ~(0x01 << 0);
+    TIMER1_TAV_R = PERIOD * CLK_FREQ;
+    TIMER1_ICR_R |= (0x01);
     //Timer 1A enabled
     TIMER1_CTL_R |= (0x01 << 0);
+    led_on = true;
+}
 
-    while ((TIMER1_RIS_R & 0x01) == 0);
-
+void led_poll(void)
+{
+    if(!led_on || ((TIMER1_RIS_R & 0x01) == 0))
+        return;
 
     //clear timer 1A flag
     TIMER1_ICR_R |= (0x01);
@@ -567,4 +772,5 @@ void onBoardLED(uint8_t duty_cycle_complement)
     TIMER0_TBILR_R = 0xFFFF;
     TIMER0_TBPR_R = 0xFF;
     TIMER1_TAILR_R = PERIOD * CLK_FREQ;
+    led_on = false;
 }
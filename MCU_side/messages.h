@@ -4,5 +4,15 @@
 static const char str1[] = "Rightbot";
 static const char str2[] = "Labs";
 static const char str3[] = "Rightbot Pvt Ltd";
+//Replies acknowledging an integrity mode change
+static const char str_crc16[] = "CRC16";
+static const char str_crc32c[] = "CRC32C";
+
+//Batch replies carry one of these per command instead of the string, REPLY_VALUE stands for the
+//command value itself
+enum
+{
+    REPLY_VALUE = 0, REPLY_STR1 = 1, REPLY_STR2 = 2, REPLY_STR3 = 3, REPLY_CRC16 = 4, REPLY_CRC32C = 5
+};
 
 #endif //_MSG_H_
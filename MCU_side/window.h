@@ -0,0 +1,131 @@
+#ifndef _WINDOW_H_
+#define _WINDOW_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Selective-repeat transport. Every data frame carries a sequence number, up to the window size
+//of them stay in flight, each with its own retransmit timer, and the receiver answers every data
+//frame with a cumulative acknowledgement plus a bitmap of the frames it holds beyond it.
+//
+//Data frame: type (LINK_DATA16 or LINK_DATA32), seq, payload, CRC trailer over type, seq and
+//payload, least significant byte first. The payload of host requests is one command byte, the
+//payload of replies is a NUL-terminated string.
+//ACK frame: LINK_ACK, cum (next sequence number expected), sack (bit i set when cum + 1 + i has
+//been received), CRC16 over the three bytes.
+//
+//Those are the legacy frames, delimited by their NUL (requests: fixed length). Length-prefixed
+//frames carry the same fields behind a header that gives the size up front:
+//LINK_SOF, flags, seq (cum for an ACK), len, payload (sack for an ACK), CRC trailer over flags
+//to payload, least significant byte first. A reply payload then has no NUL.
+//
+//COBS frames are length-prefixed frames with the LINK_SOF slot used for the first COBS code (see
+//cobs.h) and a zero byte after them. A receiver that loses its place drops at most the frame it is
+//in and starts over at the next zero.
+
+#define LINK_DATA16         0xD0    //data frame with a CRC16 trailer
+#define LINK_DATA32         0xD1    //data frame with a CRC-32C trailer
+#define LINK_ACK            0xAC    //acknowledgement frame
+#define LINK_ACK_LEN        5
+//Upper bound of the window size, the sack bitmap covers this many frames past cum
+#define LINK_MAX_WINDOW     8
+//Largest payload, a reply string with its NUL
+#define LINK_MAX_PAYLOAD    30
+//Length-prefixed frame start marker and flags
+#define LINK_SOF            0xA5
+#define LINK_FLAG_ACK       0x01    //ACK frame
+#define LINK_FLAG_CRC32C    0x02    //CRC-32C trailer instead of CRC16
+#define LINK_FLAG_BATCH     0x04    //batch: one command per payload byte, or one reply code each
+#define LINK_FLAG_TAGGED    0x08    //the payload starts with a request ID, echoed by the reply
+#define LINK_HEADER_LEN     4
+//Largest frame in either format: header, payload, 4-byte trailer
+#define LINK_MAX_FRAME      (LINK_HEADER_LEN + LINK_MAX_PAYLOAD + 4)
+//COBS frame delimiter, and the largest COBS frame with it
+#define LINK_COBS_DELIMITER 0x00
+#define LINK_MAX_COBS_FRAME (LINK_MAX_FRAME + 1)
+
+enum
+{
+    LINK_FRAMING_LEGACY = 0,
+    LINK_FRAMING_LENGTH = 1,
+    LINK_FRAMING_COBS = 2
+};
+
+struct TxSlot
+{
+    uint8_t flags;
+    uint8_t len;
+    bool sent;
+    bool acked;
+    uint32_t sent_at;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+};
+
+//Frames base .. next-1 are in flight, frame seq lives in slot[seq % LINK_MAX_WINDOW]
+struct TxWindow
+{
+    uint8_t base;
+    uint8_t next;
+    uint8_t size;
+    struct TxSlot slot[LINK_MAX_WINDOW];
+};
+
+struct RxSlot
+{
+    bool valid;
+    uint8_t flags;
+    uint8_t len;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+};
+
+//base is the next frame to deliver, frames up to base + LINK_MAX_WINDOW - 1 are buffered
+struct RxWindow
+{
+    uint8_t base;
+    struct RxSlot slot[LINK_MAX_WINDOW];
+};
+
+void tx_window_init(struct TxWindow *win, uint8_t size);
+bool tx_window_full(const struct TxWindow *win);
+//Queues a payload as the next frame and returns its sequence number, the window must not be full.
+//flags are the LINK_FLAG_CRC32C, LINK_FLAG_BATCH and LINK_FLAG_TAGGED bits of the frame.
+uint8_t tx_window_push(struct TxWindow *win, uint8_t flags, const uint8_t *payload, uint8_t len);
+//Marks what an ACK frame acknowledges and slides the window over the acknowledged prefix
+void tx_window_ack(struct TxWindow *win, uint8_t cum, uint8_t sack);
+//Sequence number of an unacknowledged frame sent at or before now - rto, or -1. Frames not sent
+//yet count as due. Call tx_window_sent() once it is on the wire.
+int16_t tx_window_due(const struct TxWindow *win, uint32_t now, uint32_t rto);
+void tx_window_sent(struct TxWindow *win, uint8_t seq, uint32_t now);
+
+void rx_window_init(struct RxWindow *win);
+//Stores a received data frame if it falls in the window, duplicates are ignored. Returns true
+//when the frame is new. flags is kept for the receiver (LINK_FLAG_BATCH, LINK_FLAG_TAGGED), the
+//link itself does not look at it.
+bool rx_window_accept(struct RxWindow *win, uint8_t seq, uint8_t flags, const uint8_t *payload, uint8_t len);
+//Copies out the next in-order payload and its flags, returns its length or -1 if it has not
+//arrived yet
+int16_t rx_window_deliver(struct RxWindow *win, uint8_t *payload, uint8_t *flags);
+//cum and sack fields of the ACK frame describing what has been received
+void rx_window_ack_fields(const struct RxWindow *win, uint8_t *cum, uint8_t *sack);
+
+//Frame builders, return the frame length. flags as for tx_window_push(), a legacy data frame only
+//has room for LINK_FLAG_CRC32C (type LINK_DATA32).
+uint8_t link_build_data(uint8_t *frame, uint8_t flags, uint8_t seq, const uint8_t *payload, uint8_t len);
+uint8_t link_build_ack(uint8_t *frame, uint8_t cum, uint8_t sack);
+uint8_t link_build_framed_data(uint8_t *frame, uint8_t flags, uint8_t seq, const uint8_t *payload, uint8_t len);
+uint8_t link_build_framed_ack(uint8_t *frame, uint8_t cum, uint8_t sack);
+
+//Length-prefixed frames: trailer size for the flags byte, total size once the header is in (0 if
+//len is out of range), and the CRC check of a complete frame. crc is the finished CRC16 or CRC-32C
+//(as the flags select) of flags to payload, which the receiver folds in as the bytes arrive.
+uint8_t link_trailer_len(uint8_t flags);
+uint8_t link_framed_len(const uint8_t *header);
+bool link_check_framed(const uint8_t *frame, uint32_t crc);
+
+//COBS: encodes a length-prefixed frame of len bytes in place and appends the delimiter, returns the
+//new length. link_check_cobs() takes a decoded frame of len bytes, restores its LINK_SOF and checks
+//its size and CRC. The frame only exists once it is decoded, so its CRC is worked out here.
+uint8_t link_cobs_wrap(uint8_t *frame, uint8_t len);
+bool link_check_cobs(uint8_t *frame, uint8_t len);
+
+#endif //_WINDOW_H_
@@ -0,0 +1,340 @@
+#include "serial/async.h"
+
+#if defined(__linux__) && __cplusplus >= 202002L
+
+#include <climits>
+
+using serial::AsyncSerial;
+using serial::CancelSource;
+using serial::Deadline;
+using serial::IoContext;
+using serial::Serial;
+using serial::Task;
+using serial::Timeout;
+using serial::detail::Waiter;
+
+// Top-level frame of a spawned coroutine, owned by the IoContext
+struct IoContext::Detached {
+  struct promise_type {
+    Detached
+    get_return_object () {
+      return Detached {
+        std::coroutine_handle<promise_type>::from_promise (*this)};
+    }
+    std::suspend_always initial_suspend () noexcept { return {}; }
+    std::suspend_never final_suspend () noexcept { return {}; }
+    void return_void () {}
+    void unhandled_exception () { std::terminate (); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// Yields the address of the awaiting coroutine's frame without suspending
+struct FrameAddress {
+  void *address;
+  bool await_ready () const noexcept { return false; }
+  bool
+  await_suspend (std::coroutine_handle<> handle) noexcept {
+    address = handle.address ();
+    return false;
+  }
+  void *await_resume () const noexcept { return address; }
+};
+
+IoContext::Detached
+IoContext::runDetached (IoContext *context, Task<void> task)
+{
+  void *self = co_await FrameAddress {NULL};
+  try {
+    co_await task;
+  }
+  catch (...) {
+    if (!context->error_) {
+      context->error_ = std::current_exception ();
+    }
+  }
+  context->roots_.erase (self);
+  context->live_--;
+}
+
+void
+CancelSource::cancel ()
+{
+  if (state_->cancelled) {
+    return;
+  }
+  state_->cancelled = true;
+  while (!state_->waiters.empty ()) {
+    Waiter *waiter = state_->waiters.front ();
+    waiter->context->wake (waiter, false);
+  }
+}
+
+IoContext::IoContext () : live_ (0), stopped_ (false)
+{
+}
+
+IoContext::~IoContext ()
+{
+  // Unlink every parked waiter before their frames go away
+  while (!timers_.empty ()) {
+    wake (timers_.begin ()->second, false);
+  }
+  for (auto &entry : ports_) {
+    while (!entry.second.readers.empty ()) {
+      wake (entry.second.readers.front (), false);
+    }
+    while (!entry.second.writers.empty ()) {
+      wake (entry.second.writers.front (), false);
+    }
+  }
+  ready_.clear ();
+  std::vector<std::coroutine_handle<> > roots;
+  for (auto &entry : roots_) {
+    roots.push_back (entry.second);
+  }
+  roots_.clear ();
+  for (size_t i = 0; i < roots.size (); i++) {
+    roots[i].destroy ();
+  }
+}
+
+void
+IoContext::spawn (Task<void> task)
+{
+  Detached detached = runDetached (this, std::move (task));
+  roots_[detached.handle.address ()] = detached.handle;
+  live_++;
+  detached.handle.resume ();
+}
+
+void
+IoContext::run ()
+{
+  while (!stopped_) {
+    resumeReady ();
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = nullptr;
+      std::rethrow_exception (error);
+    }
+    if (live_ == 0) {
+      break;
+    }
+    reactor_.poll (nextTimeout ());
+    Deadline now = std::chrono::steady_clock::now ();
+    while (!timers_.empty () && timers_.begin ()->first <= now) {
+      wake (timers_.begin ()->second, false);
+    }
+  }
+  stopped_ = false;
+}
+
+void
+IoContext::stop ()
+{
+  stopped_ = true;
+  reactor_.stop ();
+}
+
+Task<bool>
+IoContext::sleep_until (Deadline deadline, CancelToken token)
+{
+  ReadyAwaiter awaiter {this, NULL, deadline, token, Waiter ()};
+  co_await awaiter;
+  // Woken by the timer means the full sleep happened
+  co_return !token.cancelled ();
+}
+
+bool
+IoContext::ReadyAwaiter::await_suspend (std::coroutine_handle<> handle)
+{
+  if (token.cancelled () || deadline <= std::chrono::steady_clock::now ()) {
+    return false;
+  }
+  waiter.context = context;
+  waiter.handle = handle;
+  if (queue != NULL) {
+    waiter.queue = queue;
+    waiter.queue_slot = queue->insert (queue->end (), &waiter);
+  }
+  if (deadline != Deadline::max ()) {
+    waiter.timed = true;
+    waiter.timer_slot = context->timers_.insert (
+      std::make_pair (deadline, &waiter));
+  }
+  if (token.state_) {
+    waiter.cancel = token.state_;
+    waiter.cancel_slot = token.state_->waiters.insert (
+      token.state_->waiters.end (), &waiter);
+  }
+  return true;
+}
+
+void
+IoContext::attach (Serial &port)
+{
+  // Never block inside read/write, the context does the waiting
+  Timeout timeout (0, 0, 0, 0, 0);
+  port.setTimeout (timeout);
+  PortState &state = ports_[&port];
+  reactor_.add (port,
+    [this, &state] (Serial &) { wakeAll (state.readers); },
+    [this, &state] (Serial &) { wakeAll (state.writers); });
+}
+
+void
+IoContext::detach (Serial &port)
+{
+  std::unordered_map<Serial *, PortState>::iterator it = ports_.find (&port);
+  if (it == ports_.end ()) {
+    return;
+  }
+  reactor_.remove (port);
+  while (!it->second.readers.empty ()) {
+    wake (it->second.readers.front (), false);
+  }
+  while (!it->second.writers.empty ()) {
+    wake (it->second.writers.front (), false);
+  }
+  ports_.erase (it);
+}
+
+IoContext::ReadyAwaiter
+IoContext::readable (Serial &port, Deadline deadline, CancelToken token)
+{
+  return ReadyAwaiter {this, &ports_[&port].readers, deadline, token,
+                       Waiter ()};
+}
+
+IoContext::ReadyAwaiter
+IoContext::writable (Serial &port, Deadline deadline, CancelToken token)
+{
+  return ReadyAwaiter {this, &ports_[&port].writers, deadline, token,
+                       Waiter ()};
+}
+
+void
+IoContext::wake (Waiter *waiter, bool ok)
+{
+  if (waiter->queue != NULL) {
+    waiter->queue->erase (waiter->queue_slot);
+    waiter->queue = NULL;
+  }
+  if (waiter->timed) {
+    timers_.erase (waiter->timer_slot);
+    waiter->timed = false;
+  }
+  if (waiter->cancel) {
+    waiter->cancel->waiters.erase (waiter->cancel_slot);
+    waiter->cancel.reset ();
+  }
+  waiter->ok = ok;
+  ready_.push_back (waiter->handle);
+}
+
+void
+IoContext::wakeAll (std::list<Waiter *> &queue)
+{
+  while (!queue.empty ()) {
+    wake (queue.front (), true);
+  }
+}
+
+void
+IoContext::resumeReady ()
+{
+  // Resumed coroutines may make more ready, run until none are left
+  while (!ready_.empty ()) {
+    std::vector<std::coroutine_handle<> > batch;
+    batch.swap (ready_);
+    for (size_t i = 0; i < batch.size (); i++) {
+      batch[i].resume ();
+    }
+  }
+}
+
+int
+IoContext::nextTimeout () const
+{
+  if (!ready_.empty ()) {
+    return 0;
+  }
+  if (timers_.empty ()) {
+    return -1;
+  }
+  Deadline now = std::chrono::steady_clock::now ();
+  Deadline next = timers_.begin ()->first;
+  if (next <= now) {
+    return 0;
+  }
+  // Round up so the timer has expired when poll returns
+  long long ms = std::chrono::duration_cast<std::chrono::milliseconds> (
+    next - now + std::chrono::microseconds (999)).count ();
+  return ms > INT_MAX ? INT_MAX : static_cast<int> (ms);
+}
+
+AsyncSerial::AsyncSerial (IoContext &context, Serial &port)
+  : context_ (context), port_ (port)
+{
+  context_.attach (port_);
+}
+
+AsyncSerial::~AsyncSerial ()
+{
+  context_.detach (port_);
+}
+
+Task<size_t>
+AsyncSerial::read_some (uint8_t *buffer, size_t size, Deadline deadline,
+                        CancelToken token)
+{
+  size_t bytes_read = 0;
+  while (size > 0) {
+    bytes_read = port_.read (buffer, size);
+    if (bytes_read > 0) {
+      break;
+    }
+    if (!co_await context_.readable (port_, deadline, token)) {
+      break;                    // Deadline or cancelled
+    }
+  }
+  co_return bytes_read;
+}
+
+Task<size_t>
+AsyncSerial::read_frame (uint8_t *buffer, size_t size, Deadline deadline,
+                         CancelToken token)
+{
+  size_t bytes_read = 0;
+  while (bytes_read < size) {
+    bytes_read += port_.read (buffer + bytes_read, size - bytes_read);
+    if (bytes_read == size) {
+      break;
+    }
+    if (!co_await context_.readable (port_, deadline, token)) {
+      break;                    // Deadline or cancelled
+    }
+  }
+  co_return bytes_read;
+}
+
+Task<size_t>
+AsyncSerial::write (const uint8_t *data, size_t size, Deadline deadline,
+                    CancelToken token)
+{
+  size_t bytes_written = 0;
+  while (bytes_written < size) {
+    bytes_written += port_.write (data + bytes_written, size - bytes_written);
+    if (bytes_written == size) {
+      break;
+    }
+    if (!co_await context_.writable (port_, deadline, token)) {
+      break;                    // Deadline or cancelled
+    }
+  }
+  co_return bytes_written;
+}
+
+#endif // defined(__linux__) && __cplusplus >= 202002L
@@ -0,0 +1,33 @@
+#include "link/cobs.h"
+
+void cobs_encode(uint8_t *buf, uint8_t len)
+{
+    uint8_t last = 0;
+
+    for(uint8_t i = 1; i < len; i++)
+    {
+        if(buf[i] == 0)
+        {
+            buf[last] = i - last;
+            last = i;
+        }
+    }
+    buf[last] = len - last;
+}
+
+int16_t cobs_decode(uint8_t *buf, uint8_t len)
+{
+    uint8_t pos = 0;
+
+    //follow the chain of codes, each one has to land inside the block and the last exactly on its end
+    while(pos < len)
+    {
+        uint8_t code = buf[pos];
+
+        if(code == 0 || code > len - pos)
+            return -1;
+        buf[pos] = 0;
+        pos += code;
+    }
+    return len;
+}
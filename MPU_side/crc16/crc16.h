@@ -2,45 +2,42 @@
 #define _CRC16_H_
 
 #include <cstdint>
+#include <cstddef>
 
-static const uint16_t table[256] =
-{
- 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
- 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
- 0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
- 0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
- 0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
- 0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
- 0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
- 0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
- 0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
- 0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
- 0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
- 0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
- 0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
- 0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
- 0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
- 0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
- 0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
- 0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
- 0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
- 0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
- 0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
- 0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
- 0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
- 0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
- 0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
- 0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
- 0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
- 0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
- 0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
- 0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
- 0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
- 0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
-};
+//The link CRC walks the MSB-first CRC-16/CCITT table (crc::Crc16Xmodem) with an LSB-first register
+//update, so it is not one of the catalogue parameter sets in crc_engine.h. Other links can pick a
+//crc::CrcEngine directly.
 
 //CRC16 check value generation
 uint16_t crc16_ccitt(const uint8_t *data, uint8_t len);
+//Slicing-by-8/16 variants for large buffers, bit-exact with crc16_ccitt
+uint16_t crc16_ccitt_slice8(const uint8_t *data, size_t len);
+uint16_t crc16_ccitt_slice16(const uint8_t *data, size_t len);
+//Four-lane folded variant for multi-kilobyte buffers, bit-exact with crc16_ccitt
+uint16_t crc16_ccitt_fold(const uint8_t *data, size_t len);
+//Picks the fastest of the above for the given length: byte-wise, slice16, then fold from 1 KiB
+uint16_t crc16_ccitt_bulk(const uint8_t *data, size_t len);
 bool validate_message(const uint8_t *crc16_Rx_bytes, const uint8_t *data, uint8_t len);
 
+//Streaming CRC16: fold bytes in as they arrive, crc16_final() matches crc16_ccitt() over the same bytes
+uint16_t crc16_init(void);
+uint16_t crc16_update(uint16_t crc, uint8_t data);
+uint16_t crc16_final(uint16_t crc);
+bool validate_crc(const uint8_t *crc16_Rx_bytes, uint16_t calculated_crc);
+
+//Smallest per-thread share worth handing to crc16_ccitt_parallel()
+#define CRC16_PARALLEL_MIN_CHUNK    (64 * 1024)
+
+//CRC16 of A followed by B, given crc16_ccitt-style check values of both parts and the length of B
+uint16_t crc16_combine(uint16_t crcA, uint16_t crcB, size_t lenB);
+//Splits the buffer across threads (0 = one per core) and merges the chunk CRCs with crc16_combine.
+//Each thread gets at least CRC16_PARALLEL_MIN_CHUNK bytes, so a shorter buffer runs on
+//len / CRC16_PARALLEL_MIN_CHUNK threads, and on the calling thread alone below 128 KiB.
+uint16_t crc16_ccitt_parallel(const uint8_t *data, size_t len, unsigned threads);
+
+//Checks count back-to-back frames of frame_len bytes each (payload then the 2-byte CRC16 trailer,
+//as send_message() builds them). Bit i % 64 of good[i / 64] is set when frame i is intact; good
+//must hold (count + 63) / 64 words. One-byte payloads use AVX2 gathers when the CPU has them.
+void validate_batch(const uint8_t *frames, size_t frame_len, size_t count, uint64_t *good);
+
 #endif //_CRC16_H_
\ No newline at end of file
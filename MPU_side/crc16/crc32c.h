@@ -0,0 +1,18 @@
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+#include <cstdint>
+#include <cstddef>
+
+//CRC-32C (Castagnoli) check value generation, used for the trailer of data frames in
+//INTEGRITY_CRC32C mode. Uses the SSE4.2 crc32 instruction when the CPU has it and
+//crc::Crc32C tables otherwise.
+uint32_t crc32c(const uint8_t *data, size_t len);
+
+//Streaming CRC-32C: fold bytes in as they arrive, crc32c_final() matches crc32c() over the same bytes
+uint32_t crc32c_init(void);
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32c_final(uint32_t crc);
+bool validate_crc32c(const uint8_t *crc32c_Rx_bytes, uint32_t calculated_crc);
+
+#endif //_CRC32C_H_
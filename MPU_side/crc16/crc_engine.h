@@ -0,0 +1,141 @@
+#ifndef _CRC_ENGINE_H_
+#define _CRC_ENGINE_H_
+
+#include <cstdint>
+#include <cstddef>
+
+//Table-driven CRC described by the usual Rocksoft parameters (Width, Poly, Init, RefIn, RefOut, XorOut).
+//The 256-entry table is a constant expression, so each CRC variant has exactly one copy in rodata and
+//no runtime setup. Poly is given in normal (MSB-first) form for both reflected and non-reflected CRCs.
+namespace crc {
+
+template <unsigned Width> struct crc_value;
+template <> struct crc_value<8>  { typedef uint8_t type; };
+template <> struct crc_value<16> { typedef uint16_t type; };
+template <> struct crc_value<32> { typedef uint32_t type; };
+template <> struct crc_value<64> { typedef uint64_t type; };
+
+namespace detail {
+
+template <size_t... I> struct indices {};
+template <size_t N, size_t... I> struct make_indices : make_indices<N - 1, N - 1, I...> {};
+template <size_t... I> struct make_indices<0, I...> { typedef indices<I...> type; };
+
+constexpr uint64_t mask(unsigned width)
+{
+    return width >= 64 ? ~uint64_t(0) : ((uint64_t(1) << width) - 1);
+}
+
+constexpr uint64_t reflect(uint64_t value, unsigned bits)
+{
+    return bits == 0 ? 0 : (((value & 1) << (bits - 1)) | reflect(value >> 1, bits - 1));
+}
+
+//one bit of MSB-first long division
+constexpr uint64_t step_msb(uint64_t crc, unsigned width, uint64_t poly)
+{
+    return ((crc >> (width - 1)) & 1) ? (((crc << 1) ^ poly) & mask(width)) : ((crc << 1) & mask(width));
+}
+
+//one bit of LSB-first long division, poly already reflected
+constexpr uint64_t step_lsb(uint64_t crc, uint64_t rpoly)
+{
+    return (crc & 1) ? ((crc >> 1) ^ rpoly) : (crc >> 1);
+}
+
+constexpr uint64_t entry_msb(uint64_t crc, unsigned width, uint64_t poly, unsigned bits)
+{
+    return bits == 0 ? crc : entry_msb(step_msb(crc, width, poly), width, poly, bits - 1);
+}
+
+constexpr uint64_t entry_lsb(uint64_t crc, uint64_t rpoly, unsigned bits)
+{
+    return bits == 0 ? crc : entry_lsb(step_lsb(crc, rpoly), rpoly, bits - 1);
+}
+
+constexpr uint64_t entry(size_t index, unsigned width, uint64_t poly, bool refin)
+{
+    return refin ? entry_lsb(index, reflect(poly, width), 8)
+                 : entry_msb(uint64_t(index) << (width - 8), width, poly, 8);
+}
+
+//Holds one table per (Width, Poly, RefIn); engines that differ only in Init/RefOut/XorOut share it
+template <typename T, unsigned Width, uint64_t Poly, bool RefIn, typename Indices> struct table_holder;
+
+template <typename T, unsigned Width, uint64_t Poly, bool RefIn, size_t... I>
+struct table_holder<T, Width, Poly, RefIn, indices<I...> >
+{
+    static constexpr T data[256] = { T(entry(I, Width, Poly, RefIn))... };
+};
+
+template <typename T, unsigned Width, uint64_t Poly, bool RefIn, size_t... I>
+constexpr T table_holder<T, Width, Poly, RefIn, indices<I...> >::data[256];
+
+} // namespace detail
+
+template <unsigned Width, uint64_t Poly, uint64_t Init, bool RefIn, bool RefOut, uint64_t XorOut>
+class CrcEngine
+{
+    static_assert(Width >= 8, "CrcEngine handles widths of 8 bits and up");
+
+public:
+    typedef typename crc_value<Width>::type value_type;
+    typedef detail::table_holder<value_type, Width, Poly, RefIn,
+                                 typename detail::make_indices<256>::type> tables;
+
+    //256-entry lookup table, built at compile time
+    static const value_type *table()
+    {
+        return tables::data;
+    }
+
+    //Register value before the first byte
+    static value_type init()
+    {
+        return value_type(RefIn ? detail::reflect(Init, Width) : Init);
+    }
+
+    static value_type update(value_type crc, uint8_t data)
+    {
+        if (RefIn)
+            return value_type(tables::data[(crc ^ data) & 0xFF] ^ (Width > 8 ? crc >> 8 : 0));
+        else
+            return value_type(tables::data[((crc >> (Width - 8)) ^ data) & 0xFF] ^ (Width > 8 ? crc << 8 : 0));
+    }
+
+    //Folds len bytes into a running register, can be called repeatedly
+    static value_type update(value_type crc, const uint8_t *data, size_t len)
+    {
+        while (len > 0)
+        {
+            crc = update(crc, *data);
+            data++;
+            len--;
+        }
+        return crc;
+    }
+
+    //Turns a running register into the check value
+    static value_type final(value_type crc)
+    {
+        if (RefIn != RefOut)
+            crc = value_type(detail::reflect(crc, Width));
+        return value_type(crc ^ XorOut);
+    }
+
+    static value_type compute(const uint8_t *data, size_t len)
+    {
+        return final(update(init(), data, len));
+    }
+};
+
+//Common parameter sets, names as in the CRC catalogue
+typedef CrcEngine<16, 0x1021, 0xFFFF, false, false, 0x0000> Crc16CcittFalse;
+typedef CrcEngine<16, 0x1021, 0x0000, false, false, 0x0000> Crc16Xmodem;
+typedef CrcEngine<16, 0x8005, 0x0000, true, true, 0x0000> Crc16Ibm;
+typedef CrcEngine<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF> Crc32;
+typedef CrcEngine<32, 0x1EDC6F41, 0xFFFFFFFF, true, true, 0xFFFFFFFF> Crc32C;
+
+} // namespace crc
+
+#endif //_CRC_ENGINE_H_
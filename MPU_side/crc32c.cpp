@@ -0,0 +1,87 @@
+#include <cstring>
+#include "crc16/crc32c.h"
+#include "crc16/crc_engine.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42
+#endif
+
+static uint32_t crc32c_update_table(uint32_t crc, const uint8_t *data, size_t len)
+{
+    return crc::Crc32C::update(crc, data, len);
+}
+
+#ifdef CRC32C_HAVE_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_sse42(uint32_t crc, const uint8_t *data, size_t len)
+{
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+    while (len >= 4)
+    {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        len -= 4;
+    }
+    while (len > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+        data++;
+        len--;
+    }
+    return crc;
+}
+#endif
+
+typedef uint32_t (*crc32c_update_fn)(uint32_t crc, const uint8_t *data, size_t len);
+
+static crc32c_update_fn select_update(void)
+{
+#ifdef CRC32C_HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2"))
+        return crc32c_update_sse42;
+#endif
+    return crc32c_update_table;
+}
+
+uint32_t crc32c(const uint8_t *data, size_t len)
+{
+    return crc32c_final(crc32c_update(crc32c_init(), data, len));
+}
+
+uint32_t crc32c_init(void)
+{
+    return crc::Crc32C::init();
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+    //picked on first use, so callers in other translation units' static initializers are safe
+    static const crc32c_update_fn update = select_update();
+    return update(crc, data, len);
+}
+
+uint32_t crc32c_final(uint32_t crc)
+{
+    return crc::Crc32C::final(crc);
+}
+
+bool validate_crc32c(const uint8_t *crc32c_Rx_bytes, uint32_t calculated_crc)
+{
+    uint32_t received_crc = ((uint32_t)crc32c_Rx_bytes[3] << 24) | ((uint32_t)crc32c_Rx_bytes[2] << 16) |
+                            ((uint32_t)crc32c_Rx_bytes[1] << 8) | (crc32c_Rx_bytes[0]);
+    return received_crc == calculated_crc;
+}
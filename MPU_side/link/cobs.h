@@ -0,0 +1,19 @@
+#ifndef _LINK_COBS_H_
+#define _LINK_COBS_H_
+
+#include <cstdint>
+#include <cstddef>
+
+//Consistent Overhead Byte Stuffing for blocks shorter than 254 bytes, table-free and in place.
+//The encoded block has no zero bytes, so a zero delimits it on the wire.
+//
+//The caller keeps buf[0] spare: encoding turns it into the first code and every zero in
+//buf[1] .. buf[len - 1] into the distance to the next zero, so nothing moves.
+//
+//Same coding as MCU_side/cobs.c.
+
+void cobs_encode(uint8_t *buf, uint8_t len);
+//Reverses cobs_encode(), buf[0] reads back as 0. Returns len, or -1 if the block is not valid COBS.
+int16_t cobs_decode(uint8_t *buf, uint8_t len);
+
+#endif //_LINK_COBS_H_
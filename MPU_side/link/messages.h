@@ -0,0 +1,18 @@
+#ifndef _LINK_MESSAGES_H_
+#define _LINK_MESSAGES_H_
+
+#include <cstdint>
+
+//Reply codes of batch frames and the strings they stand for, same as MCU_side/messages.h.
+//REPLY_VALUE stands for the command value itself.
+enum
+{
+    REPLY_VALUE = 0, REPLY_STR1 = 1, REPLY_STR2 = 2, REPLY_STR3 = 3, REPLY_CRC16 = 4, REPLY_CRC32C = 5
+};
+
+static const char *const reply_strings[] =
+{
+    "", "Rightbot", "Labs", "Rightbot Pvt Ltd", "CRC16", "CRC32C"
+};
+
+#endif //_LINK_MESSAGES_H_
@@ -23,6 +23,7 @@
 #include <unistd.h>
 
 #include "serial/serial.h"
+#include "serial/unix.h"
 
 using serial::PortInfo;
 using std::istringstream;
@@ -200,6 +201,23 @@ get_sysfs_info(const string& device_path)
     return result;
 }
 
+string
+serial::usb_latency_timer_path(const string& port)
+{
+    // Resolves /dev/serial/by-id and similar links to the tty node
+    string device_name = basename( realpath( port ) );
+
+    if( device_name.compare(0,6,"ttyUSB") != 0 )
+        return "";
+
+    string path = format( "/sys/class/tty/%s/device/latency_timer", device_name.c_str() );
+
+    if( !path_exists( path ) )
+        return "";
+
+    return path;
+}
+
 string
 read_line(const string& file)
 {
@@ -1,241 +1,531 @@
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+#include <chrono>
 #include <cstring>
 #include <cstdint>
 #include <cstdbool>
+#include <cstdlib>
+#include <poll.h>
+#include <unistd.h>
 #include "serial/serial.h"
 #include "crc16/crc16.h"
+#include "crc16/crc32c.h"
+#include "link/window.h"
+#include "link/cobs.h"
+#include "link/messages.h"
 
-#define RW_TIMEOUT 1000
-#define STR_SIZE    30
+//Read timeout, also the longest the loop waits for the MCU before looking at stdin again
+#define LINK_POLL_MS    10
+//Requests kept in flight by default, --window changes it (1 is stop-and-wait)
+#define LINK_TX_WINDOW  4
+//Serial line rate, 8N1 puts ten bits on the wire per byte
+#define LINK_BAUDRATE   2400
+#define LINK_BYTE_BITS  10
+//The default retransmit timeout covers a full window of the largest frames each way on the wire
+//(a frame waits behind the window ahead of it, its ACK behind the replies) plus this much for
+//the MCU and the USB latency. --rto overrides it.
+#define LINK_RTO_MARGIN_MS  200
+
+//Control values outside the 0-100 user data range, they select the trailer of data frames
+#define CMD_INTEGRITY_CRC16     0xF0
+#define CMD_INTEGRITY_CRC32C    0xF1
 
 enum
 {
-	SEND_DATA = 1,
-	SEND_CRC = 2,
-	GET_DATA = 3,
-	GET_CRC = 4,
+    GET_TYPE = 1,
+    GET_HEADER = 2,
+    GET_DATA = 3,
+    GET_CRC = 4,
+    GET_PAYLOAD = 5,
 };
 
-enum
+void read_user_data(void);
+void send_pending(void);
+void send_frame(uint8_t *frame, uint8_t len);
+void parse_message(void);
+void parse_cobs(void);
+void rx_crc_start(bool use_crc32c);
+void rx_crc_fold(const uint8_t *data, size_t len);
+uint32_t rx_crc_final(void);
+bool check_legacy_frame(const uint8_t *frame, uint8_t len, uint32_t crc);
+void handle_frame(uint8_t flags, uint8_t seq, const uint8_t *payload, uint8_t len);
+void display_rx_string(const uint8_t *rx_str, int16_t len);
+void complete_request(uint8_t flags, const uint8_t *payload, uint8_t len);
+uint32_t default_rto_ms(int window);
+uint32_t now_ms(void);
+
+struct TxWindow txWin;
+struct RxWindow rxWin;
+
+std::deque<uint8_t> user_values;
+//Values of the requests waiting for a reply, by request ID. Replies echo the ID, so they are
+//matched here in whatever order they arrive.
+std::map<uint8_t, std::vector<uint8_t> > pending;
+uint8_t next_request_id = 0;
+std::string input_line;
+bool input_open = true;
+bool ack_pending = false;
+//running CRC of the frame being received, folded in as the bytes arrive so the end-of-frame check is one compare
+uint16_t rx_crc16;
+uint32_t rx_crc32c;
+bool rx_crc32c_mode = false;
+uint32_t rto_ms = 0;
+uint8_t link_framing = LINK_FRAMING_LENGTH;
+int batch_size = LINK_MAX_PAYLOAD - 1;
+uint32_t responses_due = 0;
+
+serial::Serial my_serial("/dev/ttyACM0", LINK_BAUDRATE, serial::Timeout::simpleTimeout(LINK_POLL_MS), serial::eightbits,
+    serial::parity_none, serial::stopbits_one, serial::flowcontrol_none);
+
+int main(int argc, char *argv[])
 {
-	STR_HEADER = 11,
-	STR_ENDING = 12,
-};
+    int tx_window = LINK_TX_WINDOW;
+    bool negotiate_crc32c = false;
 
-enum
+    for(int index = 1; index < argc; index++)
+    {
+        //--crc32c: switch responses to a CRC-32C trailer before the first user value
+        if(strcmp(argv[index], "--crc32c") == 0)
+            negotiate_crc32c = true;
+        //--window N: requests in flight, up to LINK_MAX_WINDOW
+        else if(strcmp(argv[index], "--window") == 0 && index + 1 < argc)
+            tx_window = atoi(argv[++index]);
+        //--rto MS: retransmit timeout, at least the round trip of a full window. The default is
+        //worked out from the window and the baud rate, about 1.5 s for 4 frames at 2400 baud.
+        else if(strcmp(argv[index], "--rto") == 0 && index + 1 < argc)
+            rto_ms = atoi(argv[++index]);
+        //--legacy-framing: NUL-delimited frames instead of length-prefixed ones, the MCU answers
+        //in whichever format it receives
+        else if(strcmp(argv[index], "--legacy-framing") == 0)
+            link_framing = LINK_FRAMING_LEGACY;
+        //--cobs: zero-delimited COBS frames, for an MCU built with LINK_COBS
+        else if(strcmp(argv[index], "--cobs") == 0)
+            link_framing = LINK_FRAMING_COBS;
+        //--batch N: values per request frame when several are waiting, 1 sends one per frame
+        else if(strcmp(argv[index], "--batch") == 0 && index + 1 < argc)
+            batch_size = atoi(argv[++index]);
+    }
+    //the request ID takes one payload byte
+    if(batch_size < 1 || batch_size > LINK_MAX_PAYLOAD - 1)
+        batch_size = LINK_MAX_PAYLOAD - 1;
+    //a legacy request is a single byte followed by its CRC, without an ID
+    if(link_framing == LINK_FRAMING_LEGACY)
+        batch_size = 1;
+    if(tx_window < 1 || tx_window > LINK_MAX_WINDOW)
+        tx_window = LINK_TX_WINDOW;
+    //a shorter timeout fires before a full window is on the wire and resends frames that are fine
+    if(rto_ms == 0)
+        rto_ms = default_rto_ms(tx_window);
+
+    tx_window_init(&txWin, tx_window);
+    rx_window_init(&rxWin);
+
+    //the receive loop polls available() and reads one byte at a time, let the port read ahead
+    my_serial.setReadAhead(256);
+
+    //ACKs and requests queued in one pass leave together, send_pending() flushes at its end
+    my_serial.setWriteCoalescing(64, 1000);
+
+    if(negotiate_crc32c)
+        user_values.push_back(CMD_INTEGRITY_CRC32C);
+
+    if(isatty(STDIN_FILENO))
+        std::cout << "Enter user data (0-100)" << std::endl;
+
+    //Values are sent as soon as the window has room, responses are displayed in request order
+    //and the loop ends once stdin is closed and every response has arrived
+    while(input_open || !user_values.empty() || responses_due > 0 || ack_pending)
+    {
+        uint8_t rx_str[LINK_MAX_PAYLOAD];
+        uint8_t rx_flags;
+        int16_t rx_len;
+
+        if(input_open)
+            read_user_data();
+
+        send_pending();
+
+        my_serial.waitReadable();
+        parse_message();
+
+        //tagged replies were taken as they arrived, the window only has to move past them
+        while((rx_len = rx_window_deliver(&rxWin, rx_str, &rx_flags)) > 0)
+        {
+            if(!(rx_flags & LINK_FLAG_TAGGED))
+            {
+                display_rx_string(rx_str, rx_len);
+                responses_due--;
+            }
+        }
+    }
+    return 0;
+}
+
+void read_user_data(void)
 {
-	CRC_1 = 21,
-	CRC_2 = 22
-};
+    struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+    char chunk[256];
 
-void send_message(void);
-void record_data(uint8_t incoming_data);
-void display_rx_string(void);
-void parse_message(void);
+    if(poll(&input, 1, 0) <= 0)
+        return;
 
-bool get_user_data_flag = true;
-bool Tx_data_flag = false;
-bool Rx_data_flag = false;
-bool data_sent = false;
-bool data_received = false;
+    ssize_t count = read(STDIN_FILENO, chunk, sizeof(chunk));
+    if(count > 0)
+    {
+        input_line.append(chunk, count);
+    }
+    else
+    {
+        //the last value may not end with a newline
+        input_open = false;
+        input_line += '\n';
+    }
 
-uint8_t data = 0;
-uint8_t crc16_Tx_bytes[2];
-uint8_t crc16_Rx_bytes[2];
-uint8_t rx_str[STR_SIZE];
-uint8_t feedback_status = 0;
-uint8_t str_index = 0;
+    //whole lines only, a value may be split across two reads
+    size_t line_end = input_line.rfind('\n');
+    if(line_end == std::string::npos)
+        return;
 
-serial::Serial my_serial("/dev/ttyACM0", 2400, serial::Timeout::simpleTimeout(RW_TIMEOUT), serial::eightbits, 
-    serial::parity_none, serial::stopbits_one, serial::flowcontrol_none);
+    std::istringstream values(input_line.substr(0, line_end));
+    input_line.erase(0, line_end + 1);
 
-int main(void)
+    int temp_data;
+    while(values >> temp_data)
+        user_values.push_back(uint8_t(temp_data));
+}
+
+void send_pending(void)
 {
-    while(1)
+    uint8_t frame[LINK_MAX_COBS_FRAME];
+    bool sent = false;
+
+    //ACK first, it releases the MCU's window
+    if(ack_pending)
     {
-        if(get_user_data_flag)
+        uint8_t cum, sack;
+        rx_window_ack_fields(&rxWin, &cum, &sack);
+        if(link_framing == LINK_FRAMING_LEGACY)
+            send_frame(frame, link_build_ack(frame, cum, sack));
+        else
+            send_frame(frame, link_build_framed_ack(frame, cum, sack));
+        ack_pending = false;
+        sent = true;
+    }
+
+    //requests have a CRC16 trailer and carry one command byte, or up to batch_size of them as
+    //one batch when more values are waiting. Except in legacy framing an ID goes in front.
+    while(!tx_window_full(&txWin) && !user_values.empty())
+    {
+        uint8_t data[LINK_MAX_PAYLOAD];
+        uint8_t flags = 0;
+        uint8_t count = 0;
+        std::vector<uint8_t> values;
+
+        if(link_framing != LINK_FRAMING_LEGACY)
         {
-            int temp_data;
-            std::cout << "Enter user data (0-100)" << std::endl;
-            std::cin >> temp_data;
-            data = uint8_t(temp_data);
-            
-            uint16_t crc16_checkvalue = crc16_ccitt(&data, 1);
-            crc16_Tx_bytes[0] = ((crc16_checkvalue) & (0xFF));//lower byte
-            crc16_Tx_bytes[1] = ((crc16_checkvalue >> 8) & (0xFF));//higher byte
-
-            get_user_data_flag = false;
-            Tx_data_flag = true;
+            while(pending.count(next_request_id) > 0)
+                next_request_id++;
+            flags |= LINK_FLAG_TAGGED;
+            data[count++] = next_request_id;
         }
+        while(values.size() < size_t(batch_size) && !user_values.empty())
+        {
+            data[count++] = user_values.front();
+            values.push_back(user_values.front());
+            user_values.pop_front();
+        }
+        if(values.size() > 1)
+            flags |= LINK_FLAG_BATCH;
+        if(flags & LINK_FLAG_TAGGED)
+            pending[next_request_id++] = values;
+
+        tx_window_push(&txWin, flags, data, count);
+        responses_due += values.size();
+    }
+
+    //new requests and timed out ones
+    uint32_t now = now_ms();
+    int16_t seq;
+    while((seq = tx_window_due(&txWin, now, rto_ms)) >= 0)
+    {
+        struct TxSlot *slot = &txWin.slot[seq % LINK_MAX_WINDOW];
+        if(link_framing == LINK_FRAMING_LEGACY)
+            send_frame(frame, link_build_data(frame, slot->flags, seq, slot->payload, slot->len));
         else
+            send_frame(frame, link_build_framed_data(frame, slot->flags, seq, slot->payload, slot->len));
+        tx_window_sent(&txWin, seq, now);
+        sent = true;
+    }
+
+    //the MCU answers these frames, do not let them wait for the coalescing deadline
+    if(sent)
+        my_serial.flushNow();
+}
+
+void send_frame(uint8_t *frame, uint8_t len)
+{
+    //COBS frames are length-prefixed frames encoded in place
+    if(link_framing == LINK_FRAMING_COBS)
+        len = link_cobs_wrap(frame, len);
+    my_serial.write(frame, len);
+}
+
+void parse_message(void)
+{
+    static uint8_t msg_parse_state = GET_TYPE;
+    static uint8_t rx_frame[LINK_MAX_FRAME];
+    static uint8_t frame_len = 0;
+    static uint8_t frame_end = 0;
+    static uint8_t crc_len = 0;
+    static uint8_t crc_index = 0;
+    size_t rx_available;
+
+    if(link_framing == LINK_FRAMING_COBS)
+    {
+        parse_cobs();
+        return;
+    }
+
+    while((rx_available = my_serial.available()) > 0)
+    {
+        //the header gave the frame size, pull the rest of it with one read
+        if(msg_parse_state == GET_PAYLOAD)
+        {
+            uint8_t start = frame_len;
+            uint8_t crc_end = LINK_HEADER_LEN + rx_frame[3];
+            frame_len += my_serial.read(&rx_frame[frame_len], std::min<size_t>(rx_available, frame_end - frame_len));
+            //the payload part of what came in joins the running CRC, the trailer does not
+            if(start < crc_end)
+                rx_crc_fold(&rx_frame[start], std::min(frame_len, crc_end) - start);
+            if(frame_len == frame_end)
+            {
+                msg_parse_state = GET_TYPE;
+                if(link_check_framed(rx_frame, rx_crc_final()))
+                    handle_frame(rx_frame[1], rx_frame[2], &rx_frame[LINK_HEADER_LEN], rx_frame[3]);
+            }
+            continue;
+        }
+
+        uint8_t incoming_data;
+        my_serial.read(&incoming_data, 1);
+
+        switch(msg_parse_state)
         {
-            if(Tx_data_flag)
-            {            
-                if(!data_sent)    
-                    send_message();
-                
-                if(data_sent)
+            case GET_TYPE:
+            {
+                //a frame starts with its marker or type byte, anything else is the rest of a damaged frame
+                if(incoming_data != LINK_SOF && incoming_data != LINK_DATA16 && incoming_data != LINK_DATA32
+                   && incoming_data != LINK_ACK)
+                    break;
+                rx_frame[0] = incoming_data;
+                frame_len = 1;
+                //2-byte CRC-16 or 4-byte CRC-32C trailer, least significant byte first
+                crc_len = (incoming_data == LINK_DATA32) ? 4 : 2;
+                msg_parse_state = GET_HEADER;
+                //a legacy frame is covered from its type byte on, a length-prefixed one from its flags
+                if(incoming_data != LINK_SOF)
                 {
-                    if(my_serial.available() > 0)
-                    {
-                        my_serial.read(&feedback_status, 1);
-                        if(feedback_status == 1)
-                        {
-                            Tx_data_flag = false;
-                            Rx_data_flag = true;
-                            feedback_status = 0;
-                            data_sent = false;
-                        }
-                        else
-                        {
-                            data_sent = false;
-                        }
-                    }
+                    rx_crc_start(incoming_data == LINK_DATA32);
+                    rx_crc_fold(&incoming_data, 1);
                 }
             }
-            else if(Rx_data_flag)
+            break;
+            case GET_HEADER:
             {
-                if(!data_received)
-                    parse_message();
-
-                if(data_received)
+                //flags, seq and len of a length-prefixed frame, seq of a legacy data frame, cum and
+                //sack of a legacy ACK
+                if(rx_frame[0] == LINK_SOF && frame_len == 1)
+                    rx_crc_start(incoming_data & LINK_FLAG_CRC32C);
+                rx_crc_fold(&incoming_data, 1);
+                rx_frame[frame_len] = incoming_data;
+                frame_len++;
+                if(rx_frame[0] == LINK_SOF)
                 {
-                    if(validate_message(crc16_Rx_bytes, rx_str, str_index))
-                    {       
-                        Rx_data_flag = false;
-                        get_user_data_flag = true;
-                        feedback_status = 1;
-                        my_serial.write(&feedback_status, 1);
-
-                        display_rx_string();
-                    }
-                    else
+                    if(frame_len == LINK_HEADER_LEN)
                     {
-                        feedback_status = 0;
-                        my_serial.write(&feedback_status, 1);
+                        frame_end = link_framed_len(rx_frame);
+                        msg_parse_state = (frame_end == 0) ? GET_TYPE : GET_PAYLOAD;
                     }
-                    str_index = 0;
-                    data_received = false;
                 }
+                else if(rx_frame[0] != LINK_ACK)
+                    msg_parse_state = GET_DATA;
+                else if(frame_len == 3)
+                    msg_parse_state = GET_CRC;
             }
+            break;
+            case GET_DATA:
+            {
+                rx_crc_fold(&incoming_data, 1);
+                rx_frame[frame_len] = incoming_data;
+                frame_len++;
+                if(incoming_data == '\0')
+                    msg_parse_state = GET_CRC;
+                else if(frame_len == 2 + LINK_MAX_PAYLOAD)
+                    msg_parse_state = GET_TYPE; //no NUL within the largest payload, not a frame
+            }
+            break;
+            case GET_CRC:
+            {
+                rx_frame[frame_len] = incoming_data;
+                frame_len++;
+                crc_index++;
+                if(crc_index == crc_len)
+                {
+                    uint8_t len = frame_len - crc_len;
+                    crc_index = 0;
+                    msg_parse_state = GET_TYPE;
+                    if(check_legacy_frame(rx_frame, len, rx_crc_final()))
+                        handle_frame((rx_frame[0] == LINK_ACK) ? LINK_FLAG_ACK : 0, rx_frame[1], &rx_frame[2], len - 2);
+                }
+            }
+            break;
         }
     }
-    return 0;
 }
 
-void send_message(void)
+void parse_cobs(void)
 {
-	static uint8_t msg_send_state = SEND_DATA;
-	static uint8_t crc_state = CRC_1;
+    static uint8_t rx_frame[LINK_MAX_COBS_FRAME];
+    static uint8_t frame_len = 0;
+    static bool discard = false;
+    uint8_t chunk[256];
+    size_t count;
 
-    switch(msg_send_state)
+    //everything that is there in one read, frames end at the delimiters inside it
+    while((count = my_serial.read(chunk, std::min<size_t>(my_serial.available(), sizeof(chunk)))) > 0)
     {
-        case SEND_DATA:
+        for(size_t index = 0; index < count; index++)
         {
-            my_serial.write(&data, 1);
-            msg_send_state = SEND_CRC;
-        }
-        break;
-        case SEND_CRC:
-        {
-            switch(crc_state)
+            if(chunk[index] != LINK_COBS_DELIMITER)
             {
-                case CRC_1:
-                {
-                    my_serial.write(&crc16_Tx_bytes[0], 1);
-                    crc_state = CRC_2;
-                }
-                break;
-                case CRC_2:
+                //longer than any frame, drop it and wait for the next delimiter
+                if(frame_len == LINK_MAX_COBS_FRAME)
                 {
-                    my_serial.write(&crc16_Tx_bytes[1], 1);
-                    crc_state = CRC_1;
-                    msg_send_state = SEND_DATA;
-                    data_sent = true;
+                    frame_len = 0;
+                    discard = true;
                 }
-                break;
+                if(!discard)
+                    rx_frame[frame_len++] = chunk[index];
+                continue;
             }
+
+            if(!discard && frame_len > 0 && cobs_decode(rx_frame, frame_len) > 0
+               && link_check_cobs(rx_frame, frame_len))
+                handle_frame(rx_frame[1], rx_frame[2], &rx_frame[LINK_HEADER_LEN], rx_frame[3]);
+            frame_len = 0;
+            discard = false;
         }
-        break;
     }
 }
 
-void record_data(uint8_t incoming_data)
+void rx_crc_start(bool use_crc32c)
 {
-    rx_str[str_index] = incoming_data;
-    str_index++;
+    rx_crc32c_mode = use_crc32c;
+    rx_crc16 = crc16_init();
+    rx_crc32c = crc32c_init();
 }
 
-void display_rx_string(void)
+void rx_crc_fold(const uint8_t *data, size_t len)
 {
-    for(uint8_t index = 0; index < str_index; index++)
+    if(rx_crc32c_mode)
+    {
+        rx_crc32c = crc32c_update(rx_crc32c, data, len);
+        return;
+    }
+    for(size_t index = 0; index < len; index++)
+        rx_crc16 = crc16_update(rx_crc16, data[index]);
+}
+
+uint32_t rx_crc_final(void)
+{
+    return rx_crc32c_mode ? crc32c_final(rx_crc32c) : crc16_final(rx_crc16);
+}
+
+bool check_legacy_frame(const uint8_t *frame, uint8_t len, uint32_t crc)
+{
+    if(frame[0] == LINK_DATA32)
+        return validate_crc32c(&frame[len], crc);
+    return validate_crc(&frame[len], uint16_t(crc));
+}
+
+void handle_frame(uint8_t flags, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+    //damaged frames never get here, the sender's retransmit timer recovers them
+    if(flags & LINK_FLAG_ACK)
+    {
+        //seq is cum, the payload is the sack bitmap. An ACK without it would apply whatever byte
+        //is left in the frame buffer and mark frames as received that were not.
+        if(len == 1)
+            tx_window_ack(&txWin, seq, payload[0]);
+    }
+    else
+    {
+        //a tagged reply starts with its request ID, without it there is nothing to match and
+        //complete_request() would read past the payload
+        if((flags & LINK_FLAG_TAGGED) && len < 1)
+            return;
+
+        //every response is acknowledged, duplicates too in case the last ACK was lost. A tagged
+        //reply is matched with its request straight away, even when an earlier one is missing.
+        if(rx_window_accept(&rxWin, seq, flags & (LINK_FLAG_BATCH | LINK_FLAG_TAGGED), payload, len)
+           && (flags & LINK_FLAG_TAGGED))
+            complete_request(flags, payload, len);
+        ack_pending = true;
+    }
+}
+
+uint32_t default_rto_ms(int window)
+{
+    uint32_t window_bytes = window * LINK_MAX_COBS_FRAME;
+    return LINK_RTO_MARGIN_MS + 2 * window_bytes * LINK_BYTE_BITS * 1000 / LINK_BAUDRATE;
+}
+
+void display_rx_string(const uint8_t *rx_str, int16_t len)
+{
+    for(int16_t index = 0; index < len; index++)
     {
         std::cout << rx_str[index];
     }
     std::cout << std::endl;
 }
 
-void parse_message(void)
+void complete_request(uint8_t flags, const uint8_t *payload, uint8_t len)
+{
+    std::map<uint8_t, std::vector<uint8_t> >::iterator request = pending.find(payload[0]);
+    if(request == pending.end())
+        return;
+
+    //replies may come back out of order, so each line names the value it answers
+    const std::vector<uint8_t> &values = request->second;
+    if(flags & LINK_FLAG_BATCH)
+    {
+        //one reply code per value
+        for(size_t index = 0; index < values.size() && index + 1 < len; index++)
+        {
+            uint8_t code = payload[index + 1];
+            std::cout << unsigned(values[index]) << ": ";
+            if(code == REPLY_VALUE || code > REPLY_CRC32C)
+                std::cout << unsigned(values[index]) << std::endl;
+            else
+                std::cout << reply_strings[code] << std::endl;
+        }
+    }
+    else if(!values.empty())
+    {
+        std::cout << unsigned(values[0]) << ": ";
+        display_rx_string(&payload[1], len - 1);
+    }
+    responses_due -= values.size();
+    pending.erase(request);
+}
+
+uint32_t now_ms(void)
 {
-    static uint8_t msg_parse_state = GET_DATA;
-    static uint8_t rx_str_state = STR_HEADER;
-	static uint8_t crc_state = CRC_1;
-
-	if(my_serial.available() > 0)
-	{
-		switch(msg_parse_state)
-		{
-			case GET_DATA:
-			{
-                uint8_t incoming_data;
-				switch(rx_str_state)
-				{
-					case STR_HEADER:
-					{
-                        my_serial.read(&incoming_data, 1);
-						record_data(incoming_data);
-						rx_str_state = STR_ENDING;
-					}
-					break;
-					case STR_ENDING:
-					{
-                        my_serial.read(&incoming_data, 1);
-						if(incoming_data == '\0')
-						{
-							record_data(incoming_data);
-							rx_str_state = STR_HEADER;
-							msg_parse_state = GET_CRC;
-						}
-						else
-						{
-							record_data(incoming_data);
-						}
-					}
-					break;
-				}
-			}
-			break;
-			case GET_CRC:
-			{
-				switch(crc_state)
-				{
-					case CRC_1:
-					{
-						my_serial.read(&crc16_Rx_bytes[0], 1);
-						crc_state = CRC_2;
-					}
-					break;
-					case CRC_2:
-					{
-						my_serial.read(&crc16_Rx_bytes[1], 1);
-						crc_state = CRC_1;
-						msg_parse_state = GET_DATA;
-                        data_received = true;
-					}
-					break;
-				}
-			}
-			break;
-		}
-	}
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
@@ -0,0 +1,194 @@
+#if defined(__linux__)
+
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "serial/reactor.h"
+#include "serial/unix.h"
+
+// Events fetched per epoll_wait call
+#define REACTOR_MAX_EVENTS 64
+
+using serial::Reactor;
+using serial::Serial;
+using serial::IOException;
+using serial::PortNotOpenedException;
+
+Reactor::Reactor ()
+  : epoll_fd_ (-1), wake_fd_ (-1), stopped_ (false), dispatching_ (false)
+{
+  epoll_fd_ = ::epoll_create1 (EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) {
+    THROW (IOException, errno);
+  }
+  wake_fd_ = ::eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wake_fd_ == -1) {
+    int error = errno;
+    ::close (epoll_fd_);
+    THROW (IOException, error);
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;         // NULL marks the wake-up eventfd
+  if (::epoll_ctl (epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) == -1) {
+    int error = errno;
+    ::close (wake_fd_);
+    ::close (epoll_fd_);
+    THROW (IOException, error);
+  }
+}
+
+Reactor::~Reactor ()
+{
+  for (std::map<Serial *, Entry *>::iterator it = entries_.begin ();
+       it != entries_.end (); ++it) {
+    delete it->second;
+  }
+  for (size_t i = 0; i < graveyard_.size (); i++) {
+    delete graveyard_[i];
+  }
+  ::close (wake_fd_);
+  ::close (epoll_fd_);
+}
+
+void
+Reactor::add (Serial &port, Callback on_readable, Callback on_writable)
+{
+  int fd = port.pimpl_->getFd ();
+  if (fd == -1) {
+    throw PortNotOpenedException ("Reactor::add");
+  }
+  remove (port);
+
+  Entry *entry = new Entry;
+  entry->port = &port;
+  entry->fd = fd;
+  entry->on_readable = on_readable;
+  entry->on_writable = on_writable;
+  entry->removed = false;
+
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLET;
+  if (on_writable) {
+    ev.events |= EPOLLOUT;
+  }
+  ev.data.ptr = entry;
+  if (::epoll_ctl (epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    int error = errno;
+    delete entry;
+    THROW (IOException, error);
+  }
+  entries_[&port] = entry;
+}
+
+void
+Reactor::remove (Serial &port)
+{
+  std::map<Serial *, Entry *>::iterator it = entries_.find (&port);
+  if (it == entries_.end ()) {
+    return;
+  }
+  Entry *entry = it->second;
+  entries_.erase (it);
+  int error = 0;
+  // ENOENT/EBADF: the descriptor was already closed, which removed it
+  if (::epoll_ctl (epoll_fd_, EPOLL_CTL_DEL, entry->fd, NULL) == -1
+      && errno != ENOENT && errno != EBADF) {
+    error = errno;
+  }
+  if (dispatching_) {
+    // Later events in the current batch may still point at it
+    entry->removed = true;
+    graveyard_.push_back (entry);
+  } else {
+    delete entry;
+  }
+  if (error != 0) {
+    THROW (IOException, error);
+  }
+}
+
+size_t
+Reactor::poll (int timeout_ms)
+{
+  epoll_event events[REACTOR_MAX_EVENTS];
+  int count = ::epoll_wait (epoll_fd_, events, REACTOR_MAX_EVENTS,
+                            timeout_ms);
+  if (count == -1) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    THROW (IOException, errno);
+  }
+
+  size_t dispatched = 0;
+  dispatching_ = true;
+  try {
+    for (int i = 0; i < count; i++) {
+      Entry *entry = static_cast<Entry *> (events[i].data.ptr);
+      if (entry == NULL) {
+        uint64_t value;
+        ssize_t r = ::read (wake_fd_, &value, sizeof (value));
+        (void) r;
+        continue;
+      }
+      // Errors and hang-ups are reported as readable so the callback's
+      // read surfaces them
+      if (!entry->removed &&
+          (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        entry->on_readable (*entry->port);
+        dispatched++;
+      }
+      if (!entry->removed && (events[i].events & EPOLLOUT) &&
+          entry->on_writable) {
+        entry->on_writable (*entry->port);
+        dispatched++;
+      }
+    }
+  }
+  catch (...) {
+    reap ();
+    throw;
+  }
+  reap ();
+  return dispatched;
+}
+
+void
+Reactor::reap ()
+{
+  dispatching_ = false;
+  for (size_t i = 0; i < graveyard_.size (); i++) {
+    delete graveyard_[i];
+  }
+  graveyard_.clear ();
+}
+
+void
+Reactor::run ()
+{
+  while (!stopped_) {
+    poll (-1);
+  }
+  stopped_ = false;
+}
+
+void
+Reactor::stop ()
+{
+  stopped_ = true;
+  uint64_t one = 1;
+  ssize_t r = ::write (wake_fd_, &one, sizeof (one));
+  (void) r;
+}
+
+size_t
+Reactor::size () const
+{
+  return entries_.size ();
+}
+
+#endif // defined(__linux__)
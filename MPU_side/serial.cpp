@@ -1,13 +1,9 @@
 /* Copyright 2012 William Woodall and John Harrison */
 #include <algorithm>
-
-#if !defined(_WIN32) && !defined(__OpenBSD__) && !defined(__FreeBSD__)
-# include <alloca.h>
-#endif
-
-#if defined (__MINGW32__)
-# define alloca __builtin_alloca
-#endif
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "serial/serial.h"
 
@@ -63,17 +59,211 @@ private:
   SerialImpl *pimpl_;
 };
 
+class Serial::Coalescer {
+public:
+  Coalescer (Serial *serial, size_t threshold, uint32_t deadline_us)
+    : serial_(serial), capacity_(threshold), ring_(threshold), head_(0),
+      count_(0), deadline_(std::chrono::microseconds (deadline_us)),
+      stopping_(false) {
+    thread_ = std::thread (&Coalescer::run, this);
+  }
+
+  // Stops the background thread, whatever is still queued is dropped
+  ~Coalescer () {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one ();
+    thread_.join ();
+  }
+
+  // Queues data or writes it out, called with the write lock held. Returns
+  // the bytes accepted, fewer than length when the queue is full and the
+  // port does not drain it in time.
+  size_t
+  write (const uint8_t *data, size_t length, std::error_code &ec) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (error_) {
+      ec = error_;
+      error_.clear ();
+      return 0;
+    }
+    ec.clear ();
+    size_t accepted = 0;
+    while (accepted < length) {
+      if (count_ == 0 && length - accepted >= capacity_) {
+        lock.unlock ();
+        return accepted + serial_->pimpl_->write (data + accepted,
+                                                  length - accepted, ec);
+      }
+      if (count_ == capacity_) {
+        // Make room before taking more
+        lock.unlock ();
+        flush (ec);
+        lock.lock ();
+        if (count_ == capacity_ || (ec && ec != std::errc::timed_out)) {
+          break;
+        }
+        ec.clear ();
+        continue;
+      }
+      if (count_ == 0) {
+        due_ = std::chrono::steady_clock::now () + deadline_;
+        wake_.notify_one ();
+      }
+      accepted += push (data + accepted, length - accepted);
+    }
+    if (accepted == length && count_ == capacity_) {
+      lock.unlock ();
+      flush (ec);
+      if (ec == std::errc::timed_out) {
+        ec.clear (); // What did not fit stays queued
+      }
+    }
+    return accepted;
+  }
+
+  // Writes out the queue, called with the write lock held
+  size_t
+  flush (std::error_code &ec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ec = error_;
+    error_.clear ();
+    if (ec || count_ == 0) {
+      return 0;
+    }
+    // At most two runs, the second when the queue wraps around the ring end
+    size_t written = 0;
+    while (count_ > 0 && !ec) {
+      size_t run = std::min (count_, capacity_ - head_);
+      size_t bytes_written = serial_->pimpl_->write (&ring_[head_], run, ec);
+      head_ = (head_ + bytes_written) % capacity_;
+      count_ -= bytes_written;
+      written += bytes_written;
+      if (bytes_written < run) {
+        break;
+      }
+    }
+    if (count_ == 0) {
+      head_ = 0;
+    }
+    due_ = std::chrono::steady_clock::now () + deadline_;
+    return written;
+  }
+
+  void
+  discard () {
+    std::lock_guard<std::mutex> lock(mutex_);
+    head_ = 0;
+    count_ = 0;
+  }
+
+private:
+  // Copies as much of data as fits behind the queued bytes, called with
+  // mutex_ held
+  size_t
+  push (const uint8_t *data, size_t length) {
+    size_t n = std::min (length, capacity_ - count_);
+    size_t tail = (head_ + count_) % capacity_;
+    size_t first = std::min (n, capacity_ - tail);
+    memcpy (&ring_[tail], data, first);
+    memcpy (&ring_[0], data + first, n - first);
+    count_ += n;
+    return n;
+  }
+
+  // Flushes the queue once its oldest byte is due
+  void
+  run () {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      if (count_ == 0 || error_) {
+        wake_.wait (lock);
+      } else if (std::chrono::steady_clock::now () < due_) {
+        wake_.wait_until (lock, due_);
+      } else {
+        // The write lock comes before mutex_, like in the writers
+        lock.unlock ();
+        {
+          ScopedWriteLock write_lock(serial_->pimpl_);
+          std::error_code ec;
+          flush (ec);
+          if (ec && ec != std::errc::timed_out) {
+            std::lock_guard<std::mutex> error_lock(mutex_);
+            error_ = ec;
+          }
+        }
+        lock.lock ();
+      }
+    }
+  }
+
+  Serial *serial_;
+  size_t capacity_;           // The threshold, the queue never holds more
+  std::vector<uint8_t> ring_; // Queued bytes [head_, head_ + count_) wrapped
+  size_t head_;
+  size_t count_;
+  std::chrono::steady_clock::duration deadline_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::chrono::steady_clock::time_point due_; // When the queue must go out
+  std::error_code error_;     // Failure of a background flush
+  bool stopping_;
+  std::thread thread_;
+};
+
+namespace {
+
+class SerialErrorCategory : public std::error_category {
+public:
+  const char *
+  name () const noexcept {
+    return "serial";
+  }
+
+  string
+  message (int value) const {
+    switch (static_cast<serial::errc> (value)) {
+    case serial::errc::port_not_opened:
+      return "port not opened";
+    case serial::errc::device_disconnected:
+      return "device reports readiness but transferred no data "
+             "(device disconnected?)";
+    case serial::errc::internal_error:
+      return "internal error, this shouldn't happen";
+    }
+    return "unknown serial error";
+  }
+};
+
+} // namespace
+
+const std::error_category &
+serial::error_category ()
+{
+  static SerialErrorCategory category;
+  return category;
+}
+
 Serial::Serial (const string &port, uint32_t baudrate, serial::Timeout timeout,
                 bytesize_t bytesize, parity_t parity, stopbits_t stopbits,
                 flowcontrol_t flowcontrol)
  : pimpl_(new SerialImpl (port, baudrate, bytesize, parity,
-                                           stopbits, flowcontrol))
+                                           stopbits, flowcontrol)),
+   coalescer_(NULL)
 {
   pimpl_->setTimeout(timeout);
 }
 
 Serial::~Serial ()
 {
+  try {
+    setWriteCoalescing (0);
+  }
+  catch (const std::exception &e) {
+    // Queued bytes that cannot be written any more are lost
+  }
   delete pimpl_;
 }
 
@@ -86,7 +276,10 @@ Serial::open ()
 void
 Serial::close ()
 {
-  pimpl_->close ();
+  // A read in another thread may be using the read-ahead buffer close resets
+  ScopedReadLock rlock(this->pimpl_);
+  ScopedWriteLock wlock(this->pimpl_);
+  close_ ();
 }
 
 bool
@@ -101,6 +294,12 @@ Serial::available ()
   return pimpl_->available ();
 }
 
+size_t
+Serial::available (std::error_code &ec) noexcept
+{
+  return pimpl_->available (ec);
+}
+
 bool
 Serial::waitReadable ()
 {
@@ -108,6 +307,13 @@ Serial::waitReadable ()
   return pimpl_->waitReadable(timeout.read_timeout_constant);
 }
 
+bool
+Serial::waitReadable (std::error_code &ec) noexcept
+{
+  serial::Timeout timeout(pimpl_->getTimeout ());
+  return pimpl_->waitReadable(timeout.read_timeout_constant, ec);
+}
+
 void
 Serial::waitByteTimes (size_t count)
 {
@@ -127,23 +333,40 @@ Serial::read (uint8_t *buffer, size_t size)
   return this->pimpl_->read (buffer, size);
 }
 
+size_t
+Serial::read (uint8_t *buffer, size_t size, std::error_code &ec) noexcept
+{
+  ScopedReadLock lock(this->pimpl_);
+  return this->pimpl_->read (buffer, size, ec);
+}
+
+size_t
+Serial::read (ByteSpan buffer)
+{
+  ScopedReadLock lock(this->pimpl_);
+  return this->pimpl_->read (buffer.data, buffer.size);
+}
+
 size_t
 Serial::read (std::vector<uint8_t> &buffer, size_t size)
 {
   ScopedReadLock lock(this->pimpl_);
-  uint8_t *buffer_ = new uint8_t[size];
+  if (size == 0) {
+    return 0;
+  }
+  size_t old_size = buffer.size ();
+  buffer.resize (old_size + size);
   size_t bytes_read = 0;
 
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->pimpl_->read (&buffer[old_size], size);
   }
   catch (const std::exception &e) {
-    delete[] buffer_;
+    buffer.resize (old_size);
     throw;
   }
 
-  buffer.insert (buffer.end (), buffer_, buffer_+bytes_read);
-  delete[] buffer_;
+  buffer.resize (old_size + bytes_read);
   return bytes_read;
 }
 
@@ -151,17 +374,21 @@ size_t
 Serial::read (std::string &buffer, size_t size)
 {
   ScopedReadLock lock(this->pimpl_);
-  uint8_t *buffer_ = new uint8_t[size];
+  if (size == 0) {
+    return 0;
+  }
+  size_t old_size = buffer.size ();
+  buffer.resize (old_size + size);
   size_t bytes_read = 0;
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->pimpl_->read (
+      reinterpret_cast<uint8_t*>(&buffer[old_size]), size);
   }
   catch (const std::exception &e) {
-    delete[] buffer_;
+    buffer.resize (old_size);
     throw;
   }
-  buffer.append (reinterpret_cast<const char*>(buffer_), bytes_read);
-  delete[] buffer_;
+  buffer.resize (old_size + bytes_read);
   return bytes_read;
 }
 
@@ -177,27 +404,7 @@ size_t
 Serial::readline (string &buffer, size_t size, string eol)
 {
   ScopedReadLock lock(this->pimpl_);
-  size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-                              (alloca (size * sizeof (uint8_t)));
-  size_t read_so_far = 0;
-  while (true)
-  {
-    size_t bytes_read = this->read_ (buffer_ + read_so_far, 1);
-    read_so_far += bytes_read;
-    if (bytes_read == 0) {
-      break; // Timeout occured on reading 1 byte
-    }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
-      break; // EOL found
-    }
-    if (read_so_far == size) {
-      break; // Reached the maximum read length
-    }
-  }
-  buffer.append(reinterpret_cast<const char*> (buffer_), read_so_far);
-  return read_so_far;
+  return this->pimpl_->readLine (buffer, size, eol);
 }
 
 string
@@ -214,41 +421,47 @@ Serial::readlines (size_t size, string eol)
   ScopedReadLock lock(this->pimpl_);
   std::vector<std::string> lines;
   size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-    (alloca (size * sizeof (uint8_t)));
   size_t read_so_far = 0;
-  size_t start_of_line = 0;
   while (read_so_far < size) {
-    size_t bytes_read = this->read_ (buffer_+read_so_far, 1);
+    lines.push_back (string ());
+    string &line = lines.back ();
+    size_t bytes_read =
+      this->pimpl_->readLine (line, size - read_so_far, eol);
     read_so_far += bytes_read;
     if (bytes_read == 0) {
-      if (start_of_line != read_so_far) {
-        lines.push_back (
-          string (reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
+      lines.pop_back ();
       break; // Timeout occured on reading 1 byte
     }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
-      // EOL found
-      lines.push_back(
-        string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-          read_so_far - start_of_line));
-      start_of_line = read_so_far;
-    }
-    if (read_so_far == size) {
-      if (start_of_line != read_so_far) {
-        lines.push_back(
-          string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
-      break; // Reached the maximum read length
+    if (line.size () < eol_len ||
+        line.compare (line.size () - eol_len, eol_len, eol) != 0) {
+      break; // Timeout or maximum read length in the middle of a line
     }
   }
   return lines;
 }
 
+Serial::LineRange
+Serial::lines (string eol)
+{
+  return LineRange (this, eol);
+}
+
+Serial::LineIterator::LineIterator (Serial *serial, const string &eol)
+  : serial_(serial), eol_(eol)
+{
+  ++(*this);
+}
+
+Serial::LineIterator &
+Serial::LineIterator::operator++ ()
+{
+  line_.clear ();
+  if (serial_->readline (line_, numeric_limits<size_t>::max (), eol_) == 0) {
+    serial_ = NULL; // Timed out, become the end iterator
+  }
+  return *this;
+}
+
 size_t
 Serial::write (const string &data)
 {
@@ -264,6 +477,13 @@ Serial::write (const std::vector<uint8_t> &data)
   return this->write_ (&data[0], data.size());
 }
 
+size_t
+Serial::write (ConstByteSpan data)
+{
+  ScopedWriteLock lock(this->pimpl_);
+  return this->write_(data.data, data.size);
+}
+
 size_t
 Serial::write (const uint8_t *data, size_t size)
 {
@@ -271,19 +491,72 @@ Serial::write (const uint8_t *data, size_t size)
   return this->write_(data, size);
 }
 
+size_t
+Serial::write (const uint8_t *data, size_t size, std::error_code &ec) noexcept
+{
+  ScopedWriteLock lock(this->pimpl_);
+  if (coalescer_ != NULL) {
+    return coalescer_->write (data, size, ec);
+  }
+  return pimpl_->write (data, size, ec);
+}
+
+#if !defined(_WIN32)
+size_t
+Serial::writev (const iovec *iov, size_t count)
+{
+  std::error_code ec;
+  size_t bytes_written = writev (iov, count, ec);
+  SerialImpl::throwError (ec, "Serial::writev", __LINE__);
+  return bytes_written;
+}
+
+size_t
+Serial::writev (const iovec *iov, size_t count, std::error_code &ec) noexcept
+{
+  ScopedWriteLock lock(this->pimpl_);
+  if (coalescer_ == NULL) {
+    return pimpl_->writev (iov, count, ec);
+  }
+  size_t bytes_written = 0;
+  for (size_t i = 0; i < count && !ec; i++) {
+    bytes_written += coalescer_->write (
+      static_cast<const uint8_t *> (iov[i].iov_base), iov[i].iov_len, ec);
+  }
+  return bytes_written;
+}
+#endif
+
 size_t
 Serial::write_ (const uint8_t *data, size_t length)
 {
+  if (coalescer_ != NULL) {
+    std::error_code ec;
+    size_t bytes_written = coalescer_->write (data, length, ec);
+    SerialImpl::throwError (ec, "Serial::write", __LINE__);
+    return bytes_written;
+  }
   return pimpl_->write (data, length);
 }
 
+void
+Serial::close_ ()
+{
+  if (coalescer_ != NULL) {
+    std::error_code ec;
+    coalescer_->flush (ec);
+    coalescer_->discard ();
+  }
+  pimpl_->close ();
+}
+
 void
 Serial::setPort (const string &port)
 {
   ScopedReadLock rlock(this->pimpl_);
   ScopedWriteLock wlock(this->pimpl_);
   bool was_open = pimpl_->isOpen ();
-  if (was_open) close();
+  if (was_open) close_ ();
   pimpl_->setPort (port);
   if (was_open) open ();
 }
@@ -317,6 +590,12 @@ Serial::getBaudrate () const
   return uint32_t(pimpl_->getBaudrate ());
 }
 
+uint32_t
+Serial::getActualBaudrate () const
+{
+  return uint32_t(pimpl_->getActualBaudrate ());
+}
+
 void
 Serial::setBytesize (bytesize_t bytesize)
 {
@@ -369,6 +648,11 @@ void Serial::flush ()
 {
   ScopedReadLock rlock(this->pimpl_);
   ScopedWriteLock wlock(this->pimpl_);
+  if (coalescer_ != NULL) {
+    std::error_code ec;
+    coalescer_->flush (ec);
+    SerialImpl::throwError (ec, "Serial::flush", __LINE__);
+  }
   pimpl_->flush ();
 }
 
@@ -381,6 +665,9 @@ void Serial::flushInput ()
 void Serial::flushOutput ()
 {
   ScopedWriteLock lock(this->pimpl_);
+  if (coalescer_ != NULL) {
+    coalescer_->discard ();
+  }
   pimpl_->flushOutput ();
 }
 
@@ -428,3 +715,57 @@ bool Serial::getCD ()
 {
   return pimpl_->getCD ();
 }
+
+void Serial::setReadAhead (size_t size)
+{
+  ScopedReadLock lock(this->pimpl_);
+  pimpl_->setReadAhead (size);
+}
+
+serial::ReadAheadStats Serial::getReadAheadStats () const
+{
+  return pimpl_->getReadAheadStats ();
+}
+
+void Serial::setLowLatency (bool enabled, uint32_t busy_poll_us)
+{
+  ScopedReadLock lock(this->pimpl_);
+  pimpl_->setLowLatency (enabled, busy_poll_us);
+}
+
+serial::LowLatencyStatus Serial::getLowLatency () const
+{
+  return pimpl_->getLowLatency ();
+}
+
+void Serial::setWriteCoalescing (size_t threshold, uint32_t deadline_us)
+{
+  Coalescer *old;
+  std::error_code ec;
+  {
+    ScopedWriteLock lock(this->pimpl_);
+    old = coalescer_;
+    coalescer_ = NULL;
+    if (old != NULL) {
+      old->flush (ec);
+    }
+    if (threshold > 0) {
+      coalescer_ = new Coalescer (this, threshold, deadline_us);
+    }
+  }
+  // Joined without the write lock, its thread may be waiting for it
+  delete old;
+  SerialImpl::throwError (ec, "Serial::setWriteCoalescing", __LINE__);
+}
+
+size_t Serial::flushNow ()
+{
+  ScopedWriteLock lock(this->pimpl_);
+  if (coalescer_ == NULL) {
+    return 0;
+  }
+  std::error_code ec;
+  size_t bytes_written = coalescer_->flush (ec);
+  SerialImpl::throwError (ec, "Serial::flushNow", __LINE__);
+  return bytes_written;
+}
@@ -0,0 +1,406 @@
+/*!
+ * \file serial/async.h
+ *
+ * \section DESCRIPTION
+ *
+ * C++20 coroutine interface to serial::Serial. An IoContext runs many
+ * coroutines on one thread over a serial::Reactor; reads and writes
+ * suspend until the port is ready instead of blocking or spinning, and
+ * every operation takes an optional deadline and cancellation token.
+ *
+ *     serial::Task<void> exchange (serial::AsyncSerial &port) {
+ *       uint8_t reply[3];
+ *       co_await port.write (request, sizeof (request));
+ *       size_t n = co_await port.read_frame (reply, sizeof (reply),
+ *                                            serial::deadline_after (100));
+ *       ...
+ *     }
+ *     ctx.spawn (exchange (port));
+ *     ctx.run ();
+ *
+ * Only built as C++20 on Linux, the rest of the library stays C++11.
+ */
+
+#if defined(__linux__) && __cplusplus >= 202002L
+
+#ifndef SERIAL_ASYNC_H
+#define SERIAL_ASYNC_H
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "serial.h"
+#include "reactor.h"
+
+namespace serial {
+
+typedef std::chrono::steady_clock::time_point Deadline;
+
+/*! Deadline of operations that may wait forever. */
+inline Deadline
+no_deadline ()
+{
+  return Deadline::max ();
+}
+
+/*! Deadline the given number of milliseconds from now. */
+inline Deadline
+deadline_after (uint32_t milliseconds)
+{
+  return std::chrono::steady_clock::now () +
+         std::chrono::milliseconds (milliseconds);
+}
+
+class IoContext;
+
+namespace detail {
+
+struct Waiter;
+
+struct CancelState {
+  bool cancelled = false;
+  std::list<Waiter *> waiters;
+};
+
+} // namespace detail
+
+/*!
+ * Observes a CancelSource. A default constructed token is never cancelled.
+ */
+class CancelToken {
+public:
+  CancelToken () {}
+
+  bool
+  cancelled () const {
+    return state_ && state_->cancelled;
+  }
+
+private:
+  friend class CancelSource;
+  friend class IoContext;
+  explicit CancelToken (std::shared_ptr<detail::CancelState> state)
+    : state_(std::move (state)) {}
+
+  std::shared_ptr<detail::CancelState> state_;
+};
+
+/*!
+ * Cancels every operation waiting with one of its tokens, they return early
+ * the same way they do on a deadline. Must be used on the IoContext thread.
+ */
+class CancelSource {
+public:
+  CancelSource () : state_(std::make_shared<detail::CancelState> ()) {}
+
+  CancelToken
+  token () const {
+    return CancelToken (state_);
+  }
+
+  void
+  cancel ();
+
+  bool
+  cancelled () const {
+    return state_->cancelled;
+  }
+
+private:
+  std::shared_ptr<detail::CancelState> state_;
+};
+
+/*!
+ * Lazily started coroutine returning T. Awaiting it runs it to completion
+ * and yields its value or rethrows its exception.
+ */
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+  std::coroutine_handle<> continuation;
+  std::exception_ptr error;
+
+  std::suspend_always
+  initial_suspend () noexcept {
+    return {};
+  }
+
+  struct FinalAwaiter {
+    bool await_ready () noexcept { return false; }
+
+    template <typename Promise> std::coroutine_handle<>
+    await_suspend (std::coroutine_handle<Promise> handle) noexcept {
+      std::coroutine_handle<> next = handle.promise ().continuation;
+      return next ? next : std::noop_coroutine ();
+    }
+
+    void await_resume () noexcept {}
+  };
+
+  FinalAwaiter
+  final_suspend () noexcept {
+    return {};
+  }
+
+  void
+  unhandled_exception () {
+    error = std::current_exception ();
+  }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  std::optional<T> value;
+
+  Task<T> get_return_object ();
+
+  template <typename U> void
+  return_value (U &&result) {
+    value.emplace (std::forward<U> (result));
+  }
+
+  T
+  result () {
+    if (error) {
+      std::rethrow_exception (error);
+    }
+    return std::move (*value);
+  }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  Task<void> get_return_object ();
+
+  void return_void () {}
+
+  void
+  result () {
+    if (error) {
+      std::rethrow_exception (error);
+    }
+  }
+};
+
+} // namespace detail
+
+template <typename T>
+class Task {
+public:
+  typedef detail::Promise<T> promise_type;
+
+  Task (Task &&other) noexcept : handle_(std::exchange (other.handle_, {})) {}
+
+  Task &
+  operator= (Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy ();
+      }
+      handle_ = std::exchange (other.handle_, {});
+    }
+    return *this;
+  }
+
+  ~Task () {
+    if (handle_) {
+      handle_.destroy ();
+    }
+  }
+
+  bool await_ready () const noexcept { return false; }
+
+  std::coroutine_handle<>
+  await_suspend (std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise ().continuation = awaiting;
+    return handle_;
+  }
+
+  T
+  await_resume () {
+    return handle_.promise ().result ();
+  }
+
+private:
+  friend struct detail::Promise<T>;
+  explicit Task (std::coroutine_handle<promise_type> handle)
+    : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T> inline Task<T>
+Promise<T>::get_return_object ()
+{
+  return Task<T> (std::coroutine_handle<Promise<T> >::from_promise (*this));
+}
+
+inline Task<void>
+Promise<void>::get_return_object ()
+{
+  return Task<void> (
+    std::coroutine_handle<Promise<void> >::from_promise (*this));
+}
+
+/*
+ * One suspended coroutine waiting for a port, a deadline or both. Woken
+ * exactly once, ok tells I/O readiness apart from deadline/cancellation.
+ */
+struct Waiter {
+  IoContext *context;
+  std::coroutine_handle<> handle;
+  bool ok = false;
+  std::list<Waiter *> *queue = NULL;
+  std::list<Waiter *>::iterator queue_slot;
+  bool timed = false;
+  std::multimap<Deadline, Waiter *>::iterator timer_slot;
+  std::shared_ptr<CancelState> cancel;
+  std::list<Waiter *>::iterator cancel_slot;
+};
+
+} // namespace detail
+
+/*!
+ * Single threaded event loop running coroutines over a serial::Reactor.
+ */
+class IoContext {
+public:
+  IoContext ();
+  ~IoContext ();
+
+  /*! Starts a coroutine, it runs until its first suspension before spawn
+   *  returns and is owned by the context afterwards. An exception escaping
+   *  it is rethrown from run. */
+  void
+  spawn (Task<void> task);
+
+  /*! Runs until every spawned coroutine has finished or stop is called.
+   *
+   * \throw serial::IOException
+   */
+  void
+  run ();
+
+  /*! Makes run return, thread safe. */
+  void
+  stop ();
+
+  /*! Suspends the calling coroutine until the deadline, returns false if
+   *  cancelled first. */
+  Task<bool>
+  sleep_until (Deadline deadline, CancelToken token = CancelToken ());
+
+  /*! Number of spawned coroutines still running. */
+  size_t
+  pending () const {
+    return live_;
+  }
+
+private:
+  friend class AsyncSerial;
+  friend class CancelSource;
+
+  struct PortState {
+    std::list<detail::Waiter *> readers;
+    std::list<detail::Waiter *> writers;
+  };
+
+  // Awaitable parking the caller until the port is ready in one direction
+  struct ReadyAwaiter {
+    IoContext *context;
+    std::list<detail::Waiter *> *queue;
+    Deadline deadline;
+    CancelToken token;
+    detail::Waiter waiter;
+
+    bool await_ready () const noexcept { return false; }
+    bool await_suspend (std::coroutine_handle<> handle);
+    bool await_resume () const noexcept { return waiter.ok; }
+  };
+
+  void attach (Serial &port);
+  void detach (Serial &port);
+  ReadyAwaiter readable (Serial &port, Deadline deadline, CancelToken token);
+  ReadyAwaiter writable (Serial &port, Deadline deadline, CancelToken token);
+
+  void wake (detail::Waiter *waiter, bool ok);
+  void wakeAll (std::list<detail::Waiter *> &queue);
+  void resumeReady ();
+  int nextTimeout () const;
+
+  Reactor reactor_;
+  std::unordered_map<Serial *, PortState> ports_;
+  std::multimap<Deadline, detail::Waiter *> timers_;
+  std::vector<std::coroutine_handle<> > ready_;
+  std::unordered_map<void *, std::coroutine_handle<> > roots_;
+  size_t live_;
+  std::atomic<bool> stopped_;
+  std::exception_ptr error_;
+
+  struct Detached;
+  static Detached runDetached (IoContext *context, Task<void> task);
+};
+
+/*!
+ * Coroutine view of a serial::Serial attached to an IoContext.
+ *
+ * Attaching sets the port's timeouts to zero so that read and write never
+ * block, waiting is done by the context. Every operation returns early with
+ * the bytes transferred so far when its deadline passes or its token is
+ * cancelled, like the blocking calls do on a Timeout.
+ */
+class AsyncSerial {
+public:
+  AsyncSerial (IoContext &context, Serial &port);
+  ~AsyncSerial ();
+
+  /*! Reads whatever is available, waiting for at least one byte. */
+  Task<size_t>
+  read_some (uint8_t *buffer, size_t size,
+             Deadline deadline = no_deadline (),
+             CancelToken token = CancelToken ());
+
+  /*! Reads exactly size bytes, one fixed size link frame. */
+  Task<size_t>
+  read_frame (uint8_t *buffer, size_t size,
+              Deadline deadline = no_deadline (),
+              CancelToken token = CancelToken ());
+
+  /*! Writes all of data, waiting whenever the output queue is full. */
+  Task<size_t>
+  write (const uint8_t *data, size_t size,
+         Deadline deadline = no_deadline (),
+         CancelToken token = CancelToken ());
+
+  Serial &
+  port () {
+    return port_;
+  }
+
+private:
+  AsyncSerial (const AsyncSerial &);
+  AsyncSerial &operator= (const AsyncSerial &);
+
+  IoContext &context_;
+  Serial &port_;
+};
+
+} // namespace serial
+
+#endif // SERIAL_ASYNC_H
+
+#endif // defined(__linux__) && __cplusplus >= 202002L
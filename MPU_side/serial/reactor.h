@@ -0,0 +1,129 @@
+/*!
+ * \file serial/reactor.h
+ *
+ * \section DESCRIPTION
+ *
+ * Event loop that services many serial ports from a single thread using
+ * edge-triggered epoll, instead of one thread blocked in waitReadable per
+ * port. Linux only.
+ */
+
+#if defined(__linux__)
+
+#ifndef SERIAL_REACTOR_H
+#define SERIAL_REACTOR_H
+
+#include <map>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+#include "serial.h"
+
+namespace serial {
+
+/*!
+ * Dispatches readable/writable callbacks for registered serial::Serial
+ * ports.
+ *
+ * Ports are registered edge-triggered: a callback runs once per arrival of
+ * new data (or once each time the output queue drains), so a readable
+ * callback must keep reading until available () returns 0, otherwise the
+ * remaining bytes are not reported again until more arrive.
+ *
+ * A port must be open when added and stay open until removed. Callbacks may
+ * add and remove ports, including the one being dispatched. Only stop () may
+ * be called from another thread.
+ */
+class Reactor {
+public:
+  typedef std::function<void (Serial &)> Callback;
+
+  /*!
+   * Creates the epoll instance.
+   *
+   * \throw serial::IOException
+   */
+  Reactor ();
+
+  virtual ~Reactor ();
+
+  /*! Registers a port.
+   *
+   * \param port An open serial::Serial, not owned by the reactor.
+   * \param on_readable Called when new bytes have arrived.
+   * \param on_writable Called when the output queue has room again, leave
+   * empty to not watch for writability.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::IOException
+   */
+  void
+  add (Serial &port, Callback on_readable,
+       Callback on_writable = Callback ());
+
+  /*! Unregisters a port, does nothing if it was not registered.
+   *
+   * \throw serial::IOException
+   */
+  void
+  remove (Serial &port);
+
+  /*! Waits for events once and dispatches them.
+   *
+   * \param timeout_ms Milliseconds to wait, -1 waits until an event or
+   * stop (), 0 only dispatches what is already pending.
+   *
+   * \return The number of callbacks run.
+   *
+   * \throw serial::IOException
+   */
+  size_t
+  poll (int timeout_ms = -1);
+
+  /*! Dispatches events until stop () is called.
+   *
+   * \throw serial::IOException
+   */
+  void
+  run ();
+
+  /*! Makes run () return and wakes a blocked poll (), thread safe. */
+  void
+  stop ();
+
+  /*! Returns the number of registered ports. */
+  size_t
+  size () const;
+
+private:
+  // Disable copy constructors
+  Reactor(const Reactor&);
+  Reactor& operator=(const Reactor&);
+
+  struct Entry {
+    Serial *port;
+    int fd;
+    Callback on_readable;
+    Callback on_writable;
+    bool removed;
+  };
+
+  int epoll_fd_;
+  int wake_fd_;               // eventfd used by stop ()
+  std::atomic<bool> stopped_;
+
+  std::map<Serial *, Entry *> entries_;
+  // Removed while a batch was being dispatched, freed after it
+  std::vector<Entry *> graveyard_;
+  bool dispatching_;
+
+  // Ends a dispatch batch, freeing entries removed during it
+  void reap ();
+};
+
+} // namespace serial
+
+#endif // SERIAL_REACTOR_H
+
+#endif // defined(__linux__)
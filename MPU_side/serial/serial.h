@@ -37,13 +37,24 @@
 #define SERIAL_H
 
 #include <limits>
+#include <iterator>
 #include <vector>
 #include <string>
 #include <cstring>
 #include <sstream>
 #include <exception>
 #include <stdexcept>
+#include <system_error>
 #include "v8stdint.h"
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 #define THROW(exceptionClass, message) throw exceptionClass(__FILE__, \
 __LINE__, (message) )
@@ -89,6 +100,31 @@ typedef enum {
   flowcontrol_hardware
 } flowcontrol_t;
 
+/*!
+ * Errors reported by the std::error_code overloads of read, write, available
+ * and waitReadable that are not operating system errors. Those come in
+ * std::system_category, and a read or write cut short by its Timeout sets
+ * std::errc::timed_out.
+ */
+enum class errc {
+  /*! The port is not open, PortNotOpenedException in the throwing API. */
+  port_not_opened = 1,
+  /*! The port reported ready but transferred nothing, usually unplugged. */
+  device_disconnected,
+  /*! A state that should be impossible, a bug in this library. */
+  internal_error
+};
+
+/*! The std::error_category of serial::errc values. */
+const std::error_category &
+error_category ();
+
+inline std::error_code
+make_error_code (errc e)
+{
+  return std::error_code (static_cast<int> (e), error_category ());
+}
+
 /*!
  * Structure for setting the timeout of the serial port, times are
  * in milliseconds.
@@ -141,6 +177,81 @@ struct Timeout {
   {}
 };
 
+/*!
+ * System call counters of the read path, used to measure the read-ahead
+ * buffer.
+ *
+ * \see Serial::setReadAhead
+ */
+struct ReadAheadStats {
+  /*! read(2) and ioctl(TIOCINQ) calls issued on behalf of read and available. */
+  uint64_t syscalls;
+  /*! Calls to read and available answered from the buffer without a system
+   *  call. */
+  uint64_t syscalls_saved;
+
+  ReadAheadStats () : syscalls(0), syscalls_saved(0) {}
+};
+
+/*!
+ * What Serial::setLowLatency could apply to the open port, drivers differ in
+ * which of the settings they support.
+ */
+struct LowLatencyStatus {
+  /*! ASYNC_LOW_LATENCY is set on the tty driver. */
+  bool async_low_latency;
+  /*! Latency timer of the USB serial adapter in milliseconds, -1 if the
+   *  port has none or it could not be read. */
+  int latency_timer_ms;
+  /*! How long read waits spin before sleeping, in microseconds. */
+  uint32_t busy_poll_us;
+
+  LowLatencyStatus () : async_low_latency(false), latency_timer_ms(-1),
+                        busy_poll_us(0) {}
+};
+
+/*!
+ * Non-owning view of caller storage that read fills in place.
+ *
+ * Converts from a pointer and length, and from std::span<uint8_t> when
+ * built as C++20.
+ */
+struct ByteSpan {
+  uint8_t *data;
+  size_t size;
+
+  ByteSpan (uint8_t *data_, size_t size_) : data(data_), size(size_) {}
+#if __cplusplus >= 202002L
+  ByteSpan (std::span<uint8_t> s) : data(s.data ()), size(s.size ()) {}
+#endif
+};
+
+/*!
+ * Non-owning read-only view of bytes for write.
+ *
+ * Converts from a pointer and length, and from std::string_view (C++17) or
+ * std::span<const uint8_t> (C++20) so callers never build a temporary
+ * std::string or std::vector just to send data.
+ */
+struct ConstByteSpan {
+  const uint8_t *data;
+  size_t size;
+
+  ConstByteSpan (const void *data_, size_t size_)
+    : data(static_cast<const uint8_t *> (data_)), size(size_) {}
+#if __cplusplus >= 201703L
+  ConstByteSpan (std::string_view s)
+    : data(reinterpret_cast<const uint8_t *> (s.data ())), size(s.size ()) {}
+#endif
+#if __cplusplus >= 202002L
+  ConstByteSpan (std::span<const uint8_t> s)
+    : data(s.data ()), size(s.size ()) {}
+#endif
+};
+
+class Reactor;
+class UringEngine;
+
 /*!
  * Class that provides a portable serial port interface.
  */
@@ -215,10 +326,18 @@ public:
   void
   close ();
 
-  /*! Return the number of characters in the buffer. */
+  /*! Return the number of characters in the buffer.
+   *
+   * With read-ahead enabled this is the number of bytes already buffered in
+   * user space, or the driver's count when that buffer is empty. It does not
+   * wait for a read in progress on another thread. */
   size_t
   available ();
 
+  /*! available without exceptions, errors are stored in ec. */
+  size_t
+  available (std::error_code &ec) noexcept;
+
   /*! Block until there is serial data to read or read_timeout_constant
    * number of milliseconds have elapsed. The return value is true when
    * the function exits with the port in a readable state, false otherwise
@@ -226,6 +345,10 @@ public:
   bool
   waitReadable ();
 
+  /*! waitReadable without exceptions, a timeout is not an error. */
+  bool
+  waitReadable (std::error_code &ec) noexcept;
+
   /*! Block for a period of time corresponding to the transmission time of
    * count characters at present serial settings. This may be used in con-
    * junction with waitReadable to read larger blocks of data from the
@@ -264,7 +387,43 @@ public:
   size_t
   read (uint8_t *buffer, size_t size);
 
-  /*! Read a given amount of bytes from the serial port into a give buffer.
+  /*! Read up to buffer.size bytes straight into caller owned storage.
+   *
+   * Same blocking and timeout behaviour as read (uint8_t *, size_t), never
+   * allocates.
+   *
+   * \param buffer A serial::ByteSpan over the destination.
+   *
+   * \return A size_t representing the number of bytes read.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   */
+  size_t
+  read (ByteSpan buffer);
+
+  /*! Read like read (uint8_t *, size_t), but report errors through ec
+   *  instead of throwing, for hot paths that cannot afford exceptions.
+   *
+   * ec is cleared on success, set to std::errc::timed_out when fewer than
+   * size bytes arrived in time, to a serial::errc or to a system error
+   * otherwise. The bytes read before a timeout or error are still returned.
+   *
+   * \param buffer An uint8_t array of at least the requested size.
+   * \param size A size_t defining how many bytes to be read.
+   * \param ec Receives the outcome.
+   *
+   * \return The number of bytes read.
+   */
+  size_t
+  read (uint8_t *buffer, size_t size, std::error_code &ec) noexcept;
+
+  /*! Read a given amount of bytes from the serial port and append them to a
+   *  given buffer.
+   *
+   * The bytes are read directly into the tail of the vector. Nothing is
+   * allocated when its capacity already covers the request, so a buffer
+   * that is cleared and reused keeps a receive loop allocation free.
    *
    * \param buffer A reference to a std::vector of uint8_t.
    * \param size A size_t defining how many bytes to be read.
@@ -278,7 +437,11 @@ public:
   size_t
   read (std::vector<uint8_t> &buffer, size_t size = 1);
 
-  /*! Read a given amount of bytes from the serial port into a give buffer.
+  /*! Read a given amount of bytes from the serial port and append them to a
+   *  given buffer.
+   *
+   * Like the std::vector overload, reads in place and only allocates when
+   * the string's capacity is exceeded.
    *
    * \param buffer A reference to a std::string.
    * \param size A size_t defining how many bytes to be read.
@@ -307,9 +470,14 @@ public:
 
   /*! Reads in a line or until a given delimiter has been processed.
    *
-   * Reads from the serial port until a single line has been read.
+   * Reads from the serial port until a single line has been read. The
+   * chunked engine needs read-ahead (see setReadAhead): with it the port is
+   * read in chunks and the delimiter is located with memchr, bytes past the
+   * delimiter stay buffered for the next read. Without it, the default, the
+   * port is read with one read(2) per byte, so nothing past the delimiter is
+   * taken from the driver.
    *
-   * \param buffer A std::string reference used to store the data.
+   * \param buffer A std::string reference the line is appended to.
    * \param size A maximum length of a line, defaults to 65536 (2^16)
    * \param eol A string to match against for the EOL.
    *
@@ -339,7 +507,8 @@ public:
   /*! Reads in multiple lines until the serial port times out.
    *
    * This requires a timeout > 0 before it can be run. It will read until a
-   * timeout occurs and return a list of strings.
+   * timeout occurs and return a list of strings. Lines are read as readline
+   * reads them, in chunks only with read-ahead enabled.
    *
    * \param size A maximum length of combined lines, defaults to 65536 (2^16)
    *
@@ -353,6 +522,71 @@ public:
   std::vector<std::string>
   readlines (size_t size = 65536, std::string eol = "\n");
 
+  /*!
+   * Input iterator over lines read lazily from the port, see Serial::lines.
+   * Becomes equal to the end iterator when a read times out.
+   */
+  class LineIterator {
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef std::string value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const std::string *pointer;
+    typedef const std::string &reference;
+
+    LineIterator () : serial_(NULL) {}
+    LineIterator (Serial *serial, const std::string &eol);
+
+    reference operator* () const { return line_; }
+    pointer operator-> () const { return &line_; }
+    LineIterator &operator++ ();
+
+    bool operator== (const LineIterator &other) const {
+      return serial_ == other.serial_;
+    }
+    bool operator!= (const LineIterator &other) const {
+      return serial_ != other.serial_;
+    }
+
+  private:
+    Serial *serial_;
+    std::string eol_;
+    std::string line_;
+  };
+
+  /*! Range returned by Serial::lines, usable in a range-based for. */
+  class LineRange {
+  public:
+    LineRange (Serial *serial, const std::string &eol)
+      : serial_(serial), eol_(eol) {}
+
+    LineIterator begin () { return LineIterator (serial_, eol_); }
+    LineIterator end () { return LineIterator (); }
+
+  private:
+    Serial *serial_;
+    std::string eol_;
+  };
+
+  /*! Streams lines from the serial port until a read times out.
+   *
+   * Unlike readlines there is no size limit and nothing is collected, each
+   * line is read when the iterator is advanced and the line storage is
+   * reused between lines. As with readline, enable read-ahead to read the
+   * port in chunks rather than one byte per system call:
+   *
+   *     for (const std::string &line : port.lines ()) { ... }
+   *
+   * \param eol A string to match against for the EOL.
+   *
+   * \return A serial::Serial::LineRange over the incoming lines.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   */
+  LineRange
+  lines (std::string eol = "\n");
+
   /*! Write a string to the serial port.
    *
    * \param data A const reference containing the data to be written
@@ -401,6 +635,56 @@ public:
   size_t
   write (const std::string &data);
 
+  /*! Write a view of bytes to the serial port.
+   *
+   * \param data A serial::ConstByteSpan over the bytes, e.g. built from a
+   * std::string_view or std::span<const uint8_t>.
+   *
+   * \return A size_t representing the number of bytes actually written to
+   * the serial port.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   * \throw serial::IOException
+   */
+  size_t
+  write (ConstByteSpan data);
+
+  /*! Write like write (const uint8_t *, size_t), but report errors through
+   *  ec instead of throwing. A write cut short by the write timeout sets
+   *  std::errc::timed_out.
+   *
+   * \return The number of bytes written, also on timeout or error.
+   */
+  size_t
+  write (const uint8_t *data, size_t size, std::error_code &ec) noexcept;
+
+#if !defined(_WIN32)
+  /*! Write the parts of a frame kept in separate buffers, such as header,
+   *  payload and checksum, as one write without copying them together.
+   *
+   * The parts go out in order with a single writev(2) when the driver takes
+   * them all at once, under one acquisition of the write lock. Timeouts are
+   * those of write, computed over the total length.
+   *
+   * \param iov The parts, as for writev(2).
+   * \param count Number of parts.
+   *
+   * \return The total number of bytes written.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   * \throw serial::IOException
+   */
+  size_t
+  writev (const iovec *iov, size_t count);
+
+  /*! writev reporting errors through ec instead of throwing, see the
+   *  std::error_code overload of write. */
+  size_t
+  writev (const iovec *iov, size_t count, std::error_code &ec) noexcept;
+#endif
+
   /*! Sets the serial port identifier.
    *
    * \param port A const std::string reference containing the address of the
@@ -489,6 +773,9 @@ public:
    * 57600, 115200
    * Some other baudrates that are supported by some comports:
    * 128000, 153600, 230400, 256000, 460800, 500000, 921600
+   * On Linux any other rate, e.g. 1500000 or 3000000, is set through
+   * termios2 if the driver supports it; see getActualBaudrate for what the
+   * hardware could actually divide its clock down to.
    *
    * \param baudrate An integer that sets the baud rate for the serial port.
    *
@@ -508,6 +795,17 @@ public:
   uint32_t
   getBaudrate () const;
 
+  /*! Gets the baud rate the driver configured, which can differ from the
+   *  requested one when the adapter's clock does not divide to it exactly.
+   *
+   * Read back from the driver on Linux, elsewhere and while the port is
+   * closed this is the requested rate.
+   *
+   * \see Serial::setBaudrate
+   */
+  uint32_t
+  getActualBaudrate () const;
+
   /*! Sets the bytesize for the serial port.
    *
    * \param bytesize Size of each byte in the serial transmission of data,
@@ -586,7 +884,8 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
-  /*! Flush the input and output buffers */
+  /*! Flush the input and output buffers, writing out first what write
+   *  coalescing has queued. */
   void
   flush ();
 
@@ -594,7 +893,8 @@ public:
   void
   flushInput ();
 
-  /*! Flush only the output buffer */
+  /*! Flush only the output buffer, bytes queued by write coalescing are
+   *  discarded with it. */
   void
   flushOutput ();
 
@@ -647,11 +947,97 @@ public:
   bool
   getCD ();
 
+  /*! Enables or disables the user-space read-ahead buffer.
+   *
+   * When enabled, reads smaller than the buffer are served by one large
+   * non-blocking read(2) into it, and later small reads and calls to
+   * available are answered from it without a system call. readline,
+   * readlines and lines scan it in chunks and leave the bytes after a line in
+   * it, without it they read one byte per system call. Any buffered bytes
+   * are discarded when the buffer is resized or disabled.
+   *
+   * \param size Size of the buffer in bytes, 0 disables read-ahead (the
+   * default).
+   */
+  void
+  setReadAhead (size_t size);
+
+  /*! Returns the system call counters of the read-ahead buffer.
+   *
+   * \see Serial::setReadAhead
+   */
+  ReadAheadStats
+  getReadAheadStats () const;
+
+  /*! Tunes the port for round trip time rather than throughput.
+   *
+   * Enabling sets ASYNC_LOW_LATENCY on the tty driver and lowers the
+   * latency timer of USB serial adapters that have one (FTDI and similar,
+   * 16 ms by default) to 1 ms through sysfs, which usually needs root or a
+   * udev rule. Settings the driver or the permissions do not allow are
+   * skipped, getLowLatency tells what took effect. The previous driver
+   * settings are restored when disabled or when the port is closed, and
+   * applied again on open.
+   *
+   * \param enabled false restores the driver settings.
+   * \param busy_poll_us When non-zero, waits for incoming data poll the
+   * input queue for up to this many microseconds before sleeping in select,
+   * trading CPU time for wake-up latency. Linux only.
+   */
+  void
+  setLowLatency (bool enabled = true, uint32_t busy_poll_us = 0);
+
+  /*! Returns the low latency settings in effect on the port. */
+  LowLatencyStatus
+  getLowLatency () const;
+
+  /*! Makes write queue small writes and send them together, trading a
+   *  bounded delay for fewer system calls.
+   *
+   * While enabled, every write and writev overload copies its bytes into a
+   * ring of threshold bytes and returns at once. The queue goes out when it
+   * fills up, when its oldest byte has waited deadline_us, or on flushNow,
+   * flush or close. Writes of threshold bytes or more skip the queue once it
+   * is empty. A write that finds the queue full writes it out first; if the
+   * port does not take it within the write timeout, the write returns the
+   * bytes accepted so far, like any timed out write. A background thread
+   * handles the deadline, an error it meets is reported by the next write or
+   * flushNow.
+   * serial::Reactor and serial::UringEngine write around the queue.
+   *
+   * \param threshold Queued bytes that trigger a write, 0 writes out what
+   * is queued and disables coalescing (the default).
+   * \param deadline_us Longest time a byte waits in the queue, in
+   * microseconds.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   * \throw serial::IOException
+   */
+  void
+  setWriteCoalescing (size_t threshold, uint32_t deadline_us = 1000);
+
+  /*! Writes out everything write coalescing has queued without waiting for
+   *  the threshold or the deadline.
+   *
+   * \return The number of bytes written.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   * \throw serial::IOException
+   */
+  size_t
+  flushNow ();
+
 private:
   // Disable copy constructors
   Serial(const Serial&);
   Serial& operator=(const Serial&);
 
+  // Register the port's file descriptor with epoll/io_uring
+  friend class Reactor;
+  friend class UringEngine;
+
   // Pimpl idiom, d_pointer
   class SerialImpl;
   SerialImpl *pimpl_;
@@ -660,12 +1046,19 @@ private:
   class ScopedReadLock;
   class ScopedWriteLock;
 
+  // Queue of small writes set up by setWriteCoalescing, NULL when disabled
+  class Coalescer;
+  Coalescer *coalescer_;
+
   // Read common function
   size_t
   read_ (uint8_t *buffer, size_t size);
   // Write common function
   size_t
   write_ (const uint8_t *data, size_t length);
+  // Close common function, the caller holds both locks
+  void
+  close_ ();
 
 };
 
@@ -772,4 +1165,8 @@ list_ports();
 
 } // namespace serial
 
+namespace std {
+template <> struct is_error_code_enum<serial::errc> : true_type {};
+} // namespace std
+
 #endif
@@ -43,6 +43,7 @@
 #include "serial.h"
 
 #include <pthread.h>
+#include <vector>
 
 namespace serial {
 
@@ -83,21 +84,45 @@ public:
   bool
   isOpen () const;
 
+  int
+  getFd () const;
+
   size_t
   available ();
 
+  size_t
+  available (std::error_code &ec);
+
   bool
   waitReadable (uint32_t timeout);
 
+  bool
+  waitReadable (uint32_t timeout, std::error_code &ec);
+
   void
   waitByteTimes (size_t count);
 
   size_t
   read (uint8_t *buf, size_t size = 1);
 
+  size_t
+  read (uint8_t *buf, size_t size, std::error_code &ec);
+
+  size_t
+  readLine (std::string &line, size_t size, const std::string &eol);
+
   size_t
   write (const uint8_t *data, size_t length);
 
+  size_t
+  write (const uint8_t *data, size_t length, std::error_code &ec);
+
+  size_t
+  writev (const iovec *iov, size_t count);
+
+  size_t
+  writev (const iovec *iov, size_t count, std::error_code &ec);
+
   void
   flush ();
 
@@ -152,6 +177,9 @@ public:
   unsigned long
   getBaudrate () const;
 
+  unsigned long
+  getActualBaudrate () const;
+
   void
   setBytesize (bytesize_t bytesize);
 
@@ -176,6 +204,11 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  // Throws what the throwing API reports for an error of the error_code
+  // API, timeouts are not errors there.
+  static void
+  throwError (const std::error_code &ec, const char *function, int line);
+
   void
   readLock ();
 
@@ -188,9 +221,34 @@ public:
   void
   writeUnlock ();
 
+  void
+  setReadAhead (size_t size);
+
+  ReadAheadStats
+  getReadAheadStats () const;
+
+  void
+  setLowLatency (bool enabled, uint32_t busy_poll_us);
+
+  LowLatencyStatus
+  getLowLatency () const;
+
 protected:
   void reconfigurePort ();
 
+  // Puts the open port in low latency mode, remembering what it replaced.
+  void applyLowLatency ();
+
+  // Puts back the driver settings applyLowLatency replaced.
+  void restoreLowLatency ();
+
+  // Non-blocking read of at most size bytes, through the read-ahead buffer
+  // when it is enabled and the request is smaller than it.
+  ssize_t readSome (uint8_t *buf, size_t size);
+
+  // Copies up to size buffered bytes out, returns how many were copied.
+  size_t drainReadAhead (uint8_t *buf, size_t size);
+
 private:
   string port_;               // Path to the file descriptor
   int fd_;                    // The current file descriptor
@@ -201,6 +259,7 @@ private:
 
   Timeout timeout_;           // Timeout for read operations
   unsigned long baudrate_;    // Baudrate
+  unsigned long actual_baudrate_; // Baudrate the driver configured
   uint32_t byte_time_ns_;     // Nanoseconds to transmit/receive a single byte
 
   parity_t parity_;           // Parity
@@ -212,8 +271,37 @@ private:
   pthread_mutex_t read_mutex;
   // Mutex used to lock the write functions
   pthread_mutex_t write_mutex;
+
+  // User-space read-ahead buffer, bytes [rx_begin_, rx_end_) are unread.
+  // Readers change it under read_mutex; the indices and counters are also
+  // guarded by rx_mutex, so available and the stats never wait on a read.
+  std::vector<uint8_t> rx_buffer_;
+  size_t rx_begin_;
+  size_t rx_end_;
+  ReadAheadStats rx_stats_;
+  mutable pthread_mutex_t rx_mutex;
+
+  bool low_latency_;          // Requested by setLowLatency
+  uint32_t busy_poll_us_;     // Spin budget of read waits
+  bool low_latency_applied_;  // Driver settings below are saved
+  bool saved_async_low_latency_;
+  int saved_latency_timer_;   // Milliseconds, -1 if untouched
+  LowLatencyStatus low_latency_status_;
 };
 
+#if defined(__linux__)
+// Path of the sysfs latency_timer of a USB serial adapter, empty if the port
+// has none. Implemented in list_ports_linux.cpp next to the other sysfs code.
+string usb_latency_timer_path (const string &port);
+
+// Sets any baud rate with termios2 and BOTHER, false if the driver refuses.
+// Implemented in termios2_linux.cpp, <asm/termbits.h> clashes with termios.h.
+bool set_termios2_baudrate (int fd, unsigned long baudrate);
+
+// Output baud rate the driver reports through termios2, 0 on failure.
+unsigned long get_termios2_baudrate (int fd);
+#endif
+
 }
 
 #endif // SERIAL_IMPL_UNIX_H
@@ -0,0 +1,215 @@
+/*!
+ * \file serial/uring.h
+ *
+ * \section DESCRIPTION
+ *
+ * io_uring based I/O for many serial ports on one thread. Reads are
+ * multishot into a ring of buffers registered with the kernel, writes are
+ * queued and submitted in batches, so a single io_uring_enter covers many
+ * ports and frames. Linux only, kernels without io_uring (or without
+ * provided buffer rings, 5.19, or IORING_ENTER_EXT_ARG timeouts, 5.11) are
+ * reported by UringEngine::supported, refused by the constructor and
+ * should keep using serial::Reactor and the termios/pselect backend.
+ */
+
+#if defined(__linux__)
+
+#ifndef SERIAL_URING_H
+#define SERIAL_URING_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <functional>
+
+#include "serial.h"
+
+namespace serial {
+
+/*!
+ * Counters of the work done by a UringEngine.
+ */
+struct UringStats {
+  /*! io_uring_enter calls, the only system calls made after setup. */
+  uint64_t enters;
+  /*! Submission queue entries handed to the kernel. */
+  uint64_t submissions;
+  /*! Completion queue entries processed. */
+  uint64_t completions;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  /*! Writes dropped because the kernel reported an error. */
+  uint64_t write_errors;
+
+  UringStats () : enters(0), submissions(0), completions(0), bytes_read(0),
+                  bytes_written(0), write_errors(0) {}
+};
+
+/*!
+ * Services reads and writes of registered serial::Serial ports through one
+ * io_uring instance.
+ *
+ * While a port is registered its bytes are delivered to the data callback
+ * only, it must not also be read through Serial::read, and its termios VMIN
+ * is raised to 1 so the kernel can wait for data. Bytes already held
+ * in the port's read-ahead buffer are not seen by the engine. A port must
+ * be open when added and stay open until removed. Not thread safe.
+ */
+class UringEngine {
+public:
+  typedef std::function<void (Serial &, const uint8_t *, size_t)>
+    DataCallback;
+
+  /*! Returns true if this kernel can run a UringEngine. */
+  static bool
+  supported ();
+
+  /*!
+   * Sets up the rings and registers the read buffers.
+   *
+   * \param entries Submission queue size.
+   * \param buffer_size Size of each read buffer.
+   * \param buffer_count Number of read buffers shared by all ports, a power
+   * of two.
+   *
+   * \throw serial::IOException
+   * \throw std::invalid_argument
+   */
+  UringEngine (unsigned entries = 256, size_t buffer_size = 256,
+               unsigned buffer_count = 256);
+
+  virtual ~UringEngine ();
+
+  /*! Registers a port and arms its read.
+   *
+   * \param port An open serial::Serial, not owned by the engine.
+   * \param on_data Called with every chunk read from the port, the bytes
+   * are only valid during the call.
+   *
+   * \throw serial::PortNotOpenedException
+   */
+  void
+  add (Serial &port, DataCallback on_data);
+
+  /*! Cancels the port's read and unregisters it, queued writes still
+   *  complete. Does nothing if the port was not registered.
+   */
+  void
+  remove (Serial &port);
+
+  /*! Queues a write, the data is copied. It is handed to the kernel by the
+   *  next submit or poll together with every other queued request.
+   *
+   * \throw serial::PortNotOpenedException
+   */
+  void
+  write (Serial &port, const uint8_t *data, size_t length);
+
+  /*! Submits queued requests without waiting.
+   *
+   * \return The number of requests submitted.
+   *
+   * \throw serial::IOException
+   */
+  size_t
+  submit ();
+
+  /*! Submits queued requests, waits for completions and dispatches them,
+   *  all with one io_uring_enter.
+   *
+   * \param timeout_ms Milliseconds to wait, -1 waits for a completion, 0
+   * only dispatches what is already complete.
+   *
+   * \return The number of data callbacks run.
+   *
+   * \throw serial::IOException
+   */
+  size_t
+  poll (int timeout_ms = -1);
+
+  /*! Returns true when reads are multishot, false when the kernel lacks
+   *  IORING_OP_READ_MULTISHOT (6.7) and each read is re-armed. */
+  bool
+  multishot () const;
+
+  UringStats
+  getStats () const;
+
+private:
+  // Disable copy constructors
+  UringEngine(const UringEngine&);
+  UringEngine& operator=(const UringEngine&);
+
+  struct Port;
+
+  struct Op {
+    enum { READ, WRITE } kind;
+    Port *port;
+    std::vector<uint8_t> data;  // write payload
+    size_t offset;              // bytes of data already written
+  };
+
+  struct Port {
+    Serial *serial;
+    int fd;
+    DataCallback on_data;
+    Op read_op;
+    bool removed;
+    unsigned inflight;          // armed read plus writes in the kernel
+    unsigned char saved_vmin;   // restored on remove
+  };
+
+  int ring_fd_;
+
+  // Submission ring
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned *sq_array_;
+  void *sqes_;
+  size_t sqes_size_;
+  unsigned to_submit_;
+
+  // Completion ring, shares sq_ring_ with IORING_FEAT_SINGLE_MMAP
+  void *cq_ring_;
+  size_t cq_ring_size_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned cq_mask_;
+  void *cqes_;
+
+  // Provided buffer ring, buffer i lives at buffers_ + i * buffer_size_
+  void *buf_ring_;
+  size_t buf_ring_size_;
+  uint8_t *buffers_;
+  size_t buffer_size_;
+  unsigned buffer_count_;
+  unsigned short buf_tail_;
+
+  bool multishot_;
+
+  std::map<Serial *, Port *> ports_;
+  // Writes queued or in the kernel, and removed ports still waiting for
+  // their completions, freed by the destructor if the engine goes first
+  std::set<Op *> writes_;
+  std::set<Port *> removed_;
+  UringStats stats_;
+
+  void *getSqe ();
+  void restoreVmin (Port *port);
+  void armRead (Port *port);
+  void queueWrite (Op *op);
+  void recycleBuffer (unsigned short bid);
+  int enter (unsigned to_submit, unsigned min_complete, int timeout_ms);
+  size_t reap ();
+  void teardown ();
+};
+
+} // namespace serial
+
+#endif // SERIAL_URING_H
+
+#endif // defined(__linux__)
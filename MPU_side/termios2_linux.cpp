@@ -0,0 +1,47 @@
+#if defined(__linux__)
+
+/*
+ * Arbitrary baud rates through the Linux termios2 interface.
+ *
+ * struct termios2 and BOTHER come from the kernel's <asm/termbits.h>, which
+ * cannot be included together with glibc's <termios.h>, so this lives apart
+ * from unix.cpp behind two plain functions.
+ */
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+#include "serial/unix.h"
+
+bool
+serial::set_termios2_baudrate (int fd, unsigned long baudrate)
+{
+  struct termios2 options;
+
+  if (-1 == ioctl (fd, TCGETS2, &options)) {
+    return false;
+  }
+
+  // BOTHER takes the rate from c_ospeed, a zero input baud field makes the
+  // input rate follow the output rate
+  options.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+  options.c_cflag |= BOTHER;
+  options.c_ispeed = static_cast<speed_t> (baudrate);
+  options.c_ospeed = static_cast<speed_t> (baudrate);
+
+  return -1 != ioctl (fd, TCSETS2, &options);
+}
+
+unsigned long
+serial::get_termios2_baudrate (int fd)
+{
+  struct termios2 options;
+
+  if (-1 == ioctl (fd, TCGETS2, &options)) {
+    return 0;
+  }
+
+  return options.c_ospeed;
+}
+
+#endif // defined(__linux__)
@@ -6,11 +6,14 @@
 #if !defined(_WIN32)
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <sstream>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/signal.h>
 #include <errno.h>
 #include <paths.h>
@@ -18,6 +21,7 @@
 #include <termios.h>
 #include <sys/param.h>
 #include <pthread.h>
+#include <sched.h>
 
 #if defined(__linux__)
 # include <linux/serial.h>
@@ -42,6 +46,9 @@
 #endif
 #endif
 
+// USB latency timer setLowLatency asks for, in milliseconds
+#define SERIAL_LOW_LATENCY_TIMER_MS 1
+
 #if defined(MAC_OS_X_VERSION_10_3) && (MAC_OS_X_VERSION_MIN_REQUIRED >= MAC_OS_X_VERSION_10_3)
 #include <IOKit/serial/ioss.h>
 #endif
@@ -105,16 +112,37 @@ timespec_from_ms (const uint32_t millis)
   return time;
 }
 
+// Holds the read-ahead mutex for a scope
+class RxLock {
+public:
+  RxLock (pthread_mutex_t *mutex) : mutex_ (mutex) {
+    pthread_mutex_lock (mutex_);
+  }
+  ~RxLock () {
+    pthread_mutex_unlock (mutex_);
+  }
+private:
+  // Disable copy constructors
+  RxLock (const RxLock&);
+  const RxLock& operator= (RxLock);
+
+  pthread_mutex_t *mutex_;
+};
+
 Serial::SerialImpl::SerialImpl (const string &port, unsigned long baudrate,
                                 bytesize_t bytesize,
                                 parity_t parity, stopbits_t stopbits,
                                 flowcontrol_t flowcontrol)
   : port_ (port), fd_ (-1), is_open_ (false), xonxoff_ (false), rtscts_ (false),
-    baudrate_ (baudrate), parity_ (parity),
-    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol)
+    baudrate_ (baudrate), actual_baudrate_ (0), parity_ (parity),
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    rx_begin_ (0), rx_end_ (0), low_latency_ (false), busy_poll_us_ (0),
+    low_latency_applied_ (false), saved_async_low_latency_ (false),
+    saved_latency_timer_ (-1)
 {
   pthread_mutex_init(&this->read_mutex, NULL);
   pthread_mutex_init(&this->write_mutex, NULL);
+  pthread_mutex_init(&this->rx_mutex, NULL);
   if (port_.empty () == false)
     open ();
 }
@@ -124,6 +152,7 @@ Serial::SerialImpl::~SerialImpl ()
   close();
   pthread_mutex_destroy(&this->read_mutex);
   pthread_mutex_destroy(&this->write_mutex);
+  pthread_mutex_destroy(&this->rx_mutex);
 }
 
 void
@@ -154,6 +183,9 @@ Serial::SerialImpl::open ()
 
   reconfigurePort();
   is_open_ = true;
+  if (low_latency_) {
+    applyLowLatency ();
+  }
 }
 
 void
@@ -314,23 +346,8 @@ Serial::SerialImpl::reconfigurePort ()
     if (-1 == ioctl (fd_, IOSSIOSPEED, &new_baud, 1)) {
       THROW (IOException, errno);
     }
-    // Linux Support
-#elif defined(__linux__) && defined (TIOCSSERIAL)
-    struct serial_struct ser;
-
-    if (-1 == ioctl (fd_, TIOCGSERIAL, &ser)) {
-      THROW (IOException, errno);
-    }
-
-    // set custom divisor
-    ser.custom_divisor = ser.baud_base / static_cast<int> (baudrate_);
-    // update flags
-    ser.flags &= ~ASYNC_SPD_MASK;
-    ser.flags |= ASYNC_SPD_CUST;
-
-    if (-1 == ioctl (fd_, TIOCSSERIAL, &ser)) {
-      THROW (IOException, errno);
-    }
+    // Linux Support, set through termios2 once tcsetattr below is done
+#elif defined(__linux__)
 #else
     throw invalid_argument ("OS does not currently support custom bauds");
 #endif
@@ -443,8 +460,43 @@ Serial::SerialImpl::reconfigurePort ()
   // activate settings
   ::tcsetattr (fd_, TCSANOW, &options);
 
+  actual_baudrate_ = baudrate_;
+#if defined(__linux__)
+  // termios2 and BOTHER take any rate the hardware can divide down to, the
+  // custom divisor of TIOCSSERIAL is left for drivers without it
+  if (custom_baud && !set_termios2_baudrate (fd_, baudrate_)) {
+# if defined (TIOCSSERIAL)
+    struct serial_struct ser;
+
+    if (-1 == ioctl (fd_, TIOCGSERIAL, &ser)) {
+      THROW (IOException, errno);
+    }
+
+    // set custom divisor
+    ser.custom_divisor = ser.baud_base / static_cast<int> (baudrate_);
+    // update flags
+    ser.flags &= ~ASYNC_SPD_MASK;
+    ser.flags |= ASYNC_SPD_CUST;
+
+    if (-1 == ioctl (fd_, TIOCSSERIAL, &ser)) {
+      THROW (IOException, errno);
+    }
+    if (ser.custom_divisor > 0) {
+      actual_baudrate_ = ser.baud_base / ser.custom_divisor;
+    }
+# else
+    throw invalid_argument ("OS does not currently support custom bauds");
+# endif
+  }
+  // Drivers round to what their clock divides to, ask what they settled on
+  unsigned long configured = get_termios2_baudrate (fd_);
+  if (configured != 0) {
+    actual_baudrate_ = configured;
+  }
+#endif
+
   // Update byte_time_ based on the new settings.
-  uint32_t bit_time_ns = 1e9 / baudrate_;
+  uint32_t bit_time_ns = 1e9 / actual_baudrate_;
   byte_time_ns_ = bit_time_ns * (1 + bytesize_ + parity_ + stopbits_);
 
   // Compensate for the stopbits_one_point_five enum being equal to int 3,
@@ -459,6 +511,7 @@ Serial::SerialImpl::close ()
 {
   if (is_open_ == true) {
     if (fd_ != -1) {
+      restoreLowLatency ();
       int ret;
       ret = ::close (fd_);
       if (ret == 0) {
@@ -468,6 +521,10 @@ Serial::SerialImpl::close ()
       }
     }
     is_open_ = false;
+    // Serial::close holds the read lock, so no reader is between its checks
+    // of the indices and the buffer
+    RxLock lock (&rx_mutex);
+    rx_begin_ = rx_end_ = 0;
   }
 }
 
@@ -477,15 +534,61 @@ Serial::SerialImpl::isOpen () const
   return is_open_;
 }
 
+// Reports an error of the error_code API the way the throwing API always
+// has, a timeout is not an error there
+void
+Serial::SerialImpl::throwError (const std::error_code &ec,
+                                const char *function, int line)
+{
+  if (!ec || ec == std::errc::timed_out) {
+    return;
+  }
+  if (ec == serial::errc::port_not_opened) {
+    throw PortNotOpenedException (function);
+  }
+  if (ec.category () == std::system_category ()) {
+    throw IOException (__FILE__, line, ec.value ());
+  }
+  throw SerialException (ec.message ().c_str ());
+}
+
+int
+Serial::SerialImpl::getFd () const
+{
+  return is_open_ ? fd_ : -1;
+}
+
 size_t
 Serial::SerialImpl::available ()
 {
+  std::error_code ec;
+  size_t count = available (ec);
+  throwError (ec, "Serial::available", __LINE__);
+  return count;
+}
+
+size_t
+Serial::SerialImpl::available (std::error_code &ec)
+{
+  ec.clear ();
   if (!is_open_) {
     return 0;
   }
+  // Only rx_mutex is taken, a read blocked in another thread holds the read
+  // lock for its whole timeout. Bytes already buffered answer without asking
+  // the driver, otherwise this is the driver's count.
+  {
+    RxLock lock (&rx_mutex);
+    if (rx_end_ > rx_begin_) {
+      rx_stats_.syscalls_saved++;
+      return rx_end_ - rx_begin_;
+    }
+    rx_stats_.syscalls++;
+  }
   int count = 0;
   if (-1 == ioctl (fd_, TIOCINQ, &count)) {
-      THROW (IOException, errno);
+      ec.assign (errno, std::system_category ());
+      return 0;
   } else {
       return static_cast<size_t> (count);
   }
@@ -494,6 +597,58 @@ Serial::SerialImpl::available ()
 bool
 Serial::SerialImpl::waitReadable (uint32_t timeout)
 {
+  std::error_code ec;
+  bool readable = waitReadable (timeout, ec);
+  throwError (ec, "Serial::waitReadable", __LINE__);
+  return readable;
+}
+
+bool
+Serial::SerialImpl::waitReadable (uint32_t timeout, std::error_code &ec)
+{
+  ec.clear ();
+  // Bytes already read ahead are readable without asking the driver
+  {
+    RxLock lock (&rx_mutex);
+    if (rx_end_ > rx_begin_) {
+      return true;
+    }
+  }
+#if defined(__linux__)
+  if (busy_poll_us_ > 0) {
+    // Spin on the input queue first, a fast device answers sooner than the
+    // scheduler wakes a thread sleeping in pselect
+    timespec start;
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    int64_t budget_ns = std::min (static_cast<int64_t> (busy_poll_us_) * 1000,
+                                  static_cast<int64_t> (timeout) * 1000000);
+    int64_t spent_ns = 0;
+    do {
+      int count = 0;
+      if (-1 == ioctl (fd_, TIOCINQ, &count)) {
+        ec.assign (errno, std::system_category ());
+        return false;
+      }
+      if (count > 0) {
+        return true;
+      }
+      // Lets a writer sharing this CPU (the other end of a pty, a feeder
+      // thread) run, returns at once when nothing else is runnable
+      sched_yield ();
+      timespec now;
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      spent_ns = (now.tv_sec - start.tv_sec) * 1000000000LL +
+                 (now.tv_nsec - start.tv_nsec);
+    } while (spent_ns < budget_ns);
+    // A preempted spin can overrun the whole timeout, which must not wrap
+    uint32_t spent_ms = static_cast<uint32_t> (
+      std::min (spent_ns / 1000000, static_cast<int64_t> (timeout)));
+    timeout = spent_ms >= timeout ? 0 : timeout - spent_ms;
+    if (timeout == 0) {
+      return false;
+    }
+  }
+#endif
   // Setup a select call to block for serial data or a timeout
   fd_set readfds;
   FD_ZERO (&readfds);
@@ -507,7 +662,8 @@ Serial::SerialImpl::waitReadable (uint32_t timeout)
       return false;
     }
     // Otherwise there was some error
-    THROW (IOException, errno);
+    ec.assign (errno, std::system_category ());
+    return false;
   }
   // Timeout occurred
   if (r == 0) {
@@ -515,8 +671,8 @@ Serial::SerialImpl::waitReadable (uint32_t timeout)
   }
   // This shouldn't happen, if r > 0 our fd has to be in the list!
   if (!FD_ISSET (fd_, &readfds)) {
-    THROW (IOException, "select reports ready to read, but our fd isn't"
-           " in the list, this shouldn't happen!");
+    ec = make_error_code (serial::errc::internal_error);
+    return false;
   }
   // Data available to read.
   return true;
@@ -532,11 +688,27 @@ Serial::SerialImpl::waitByteTimes (size_t count)
 size_t
 Serial::SerialImpl::read (uint8_t *buf, size_t size)
 {
-  // If the port is not open, throw
+  std::error_code ec;
+  size_t bytes_read = read (buf, size, ec);
+  throwError (ec, "Serial::read", __LINE__);
+  return bytes_read;
+}
+
+size_t
+Serial::SerialImpl::read (uint8_t *buf, size_t size, std::error_code &ec)
+{
+  ec.clear ();
   if (!is_open_) {
-    throw PortNotOpenedException ("Serial::read");
+    ec = make_error_code (serial::errc::port_not_opened);
+    return 0;
+  }
+  // Serve what was read ahead first, small reads often end here
+  size_t bytes_read = drainReadAhead (buf, size);
+  if (bytes_read == size) {
+    RxLock lock (&rx_mutex);
+    rx_stats_.syscalls_saved++;
+    return bytes_read;
   }
-  size_t bytes_read = 0;
 
   // Calculate total timeout in milliseconds t_c + (t_m * N)
   long total_timeout_ms = timeout_.read_timeout_constant;
@@ -545,9 +717,9 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
 
   // Pre-fill buffer with available bytes
   {
-    ssize_t bytes_read_now = ::read (fd_, buf, size);
+    ssize_t bytes_read_now = readSome (buf + bytes_read, size - bytes_read);
     if (bytes_read_now > 0) {
-      bytes_read = bytes_read_now;
+      bytes_read += bytes_read_now;
     }
   }
 
@@ -555,6 +727,7 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
     int64_t timeout_remaining_ms = total_timeout.remaining();
     if (timeout_remaining_ms <= 0) {
       // Timed out
+      ec = make_error_code (std::errc::timed_out);
       break;
     }
     // Timeout for the next select is whichever is less of the remaining
@@ -562,12 +735,15 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
     uint32_t timeout = std::min(static_cast<uint32_t> (timeout_remaining_ms),
                                 timeout_.inter_byte_timeout);
     // Wait for the device to be readable, and then attempt to read.
-    if (waitReadable(timeout)) {
+    if (waitReadable(timeout, ec)) {
       // If it's a fixed-length multi-byte read, insert a wait here so that
       // we can attempt to grab the whole thing in a single IO call. Skip
       // this wait if a non-max inter_byte_timeout is specified.
       if (size > 1 && timeout_.inter_byte_timeout == Timeout::max()) {
-        size_t bytes_available = available();
+        size_t bytes_available = available(ec);
+        if (ec) {
+          break;
+        }
         if (bytes_available + bytes_read < size) {
           waitByteTimes(size - (bytes_available + bytes_read));
         }
@@ -575,15 +751,15 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
       // This should be non-blocking returning only what is available now
       //  Then returning so that select can block again.
       ssize_t bytes_read_now =
-        ::read (fd_, buf + bytes_read, size - bytes_read);
+        readSome (buf + bytes_read, size - bytes_read);
       // read should always return some data as select reported it was
       // ready to read when we get to this point.
       if (bytes_read_now < 1) {
         // Disconnected devices, at least on Linux, show the
         // behavior that they are always ready to read immediately
         // but reading returns nothing.
-        throw SerialException ("device reports readiness to read but "
-                               "returned no data (device disconnected?)");
+        ec = make_error_code (serial::errc::device_disconnected);
+        break;
       }
       // Update bytes_read
       bytes_read += static_cast<size_t> (bytes_read_now);
@@ -597,23 +773,306 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
       }
       // If bytes_read > size then we have over read, which shouldn't happen
       if (bytes_read > size) {
-        throw SerialException ("read over read, too many bytes where "
-                               "read, this shouldn't happen, might be "
-                               "a logical error!");
+        ec = make_error_code (serial::errc::internal_error);
+        break;
       }
+    } else if (ec) {
+      break;
     }
   }
   return bytes_read;
 }
 
+ssize_t
+Serial::SerialImpl::readSome (uint8_t *buf, size_t size)
+{
+  // Only the caller's read lock changes the indices, reading them needs no
+  // rx_mutex here
+  if (rx_end_ > rx_begin_) {
+    return static_cast<ssize_t> (drainReadAhead (buf, size));
+  }
+  {
+    RxLock lock (&rx_mutex);
+    rx_stats_.syscalls++;
+  }
+  // Large requests go straight into the caller's buffer
+  if (rx_buffer_.empty () || size >= rx_buffer_.size ()) {
+    return ::read (fd_, buf, size);
+  }
+  ssize_t bytes_read_now = ::read (fd_, &rx_buffer_[0], rx_buffer_.size ());
+  if (bytes_read_now <= 0) {
+    return bytes_read_now;
+  }
+  {
+    RxLock lock (&rx_mutex);
+    rx_begin_ = 0;
+    rx_end_ = static_cast<size_t> (bytes_read_now);
+  }
+  return static_cast<ssize_t> (drainReadAhead (buf, size));
+}
+
+size_t
+Serial::SerialImpl::drainReadAhead (uint8_t *buf, size_t size)
+{
+  RxLock lock (&rx_mutex);
+  size_t count = std::min (size, rx_end_ - rx_begin_);
+  if (count > 0) {
+    memcpy (buf, &rx_buffer_[rx_begin_], count);
+    rx_begin_ += count;
+  }
+  if (rx_begin_ == rx_end_) {
+    rx_begin_ = rx_end_ = 0;
+  }
+  return count;
+}
+
+void
+Serial::SerialImpl::setReadAhead (size_t size)
+{
+  RxLock lock (&rx_mutex);
+  std::vector<uint8_t> (size).swap (rx_buffer_);
+  rx_begin_ = rx_end_ = 0;
+}
+
+serial::ReadAheadStats
+Serial::SerialImpl::getReadAheadStats () const
+{
+  RxLock lock (&rx_mutex);
+  return rx_stats_;
+}
+
+#if defined(__linux__)
+// Reads a number from a sysfs attribute, -1 if it cannot be read
+static int
+read_sysfs_int (const string &path)
+{
+  int fd = ::open (path.c_str (), O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  char text[16];
+  ssize_t length = ::read (fd, text, sizeof (text) - 1);
+  ::close (fd);
+  if (length <= 0) {
+    return -1;
+  }
+  text[length] = '\0';
+  return atoi (text);
+}
+
+// Writes a number to a sysfs attribute, returns false if it was refused
+static bool
+write_sysfs_int (const string &path, int value)
+{
+  int fd = ::open (path.c_str (), O_WRONLY);
+  if (fd == -1) {
+    return false;
+  }
+  char text[16];
+  int length = snprintf (text, sizeof (text), "%d", value);
+  bool written = ::write (fd, text, length) == length;
+  ::close (fd);
+  return written;
+}
+#endif
+
+void
+Serial::SerialImpl::setLowLatency (bool enabled, uint32_t busy_poll_us)
+{
+#if !defined(__linux__)
+  busy_poll_us = 0;
+#endif
+  low_latency_ = enabled;
+  busy_poll_us_ = enabled ? busy_poll_us : 0;
+  if (!is_open_) {
+    return;
+  }
+  if (enabled) {
+    applyLowLatency ();
+  } else {
+    restoreLowLatency ();
+  }
+}
+
+serial::LowLatencyStatus
+Serial::SerialImpl::getLowLatency () const
+{
+  LowLatencyStatus status (low_latency_status_);
+  status.busy_poll_us = busy_poll_us_;
+  return status;
+}
+
+void
+Serial::SerialImpl::applyLowLatency ()
+{
+#if defined(__linux__)
+  // Drivers without serial_struct (ptys, some USB adapters) refuse this
+  struct serial_struct ser;
+  if (-1 != ioctl (fd_, TIOCGSERIAL, &ser)) {
+    if (!low_latency_applied_) {
+      saved_async_low_latency_ = (ser.flags & ASYNC_LOW_LATENCY) != 0;
+    }
+    ser.flags |= ASYNC_LOW_LATENCY;
+    low_latency_status_.async_low_latency =
+      -1 != ioctl (fd_, TIOCSSERIAL, &ser);
+  }
+  // FTDI style adapters hold received bytes until their latency timer
+  // expires, it dominates the round trip unless lowered
+  string path = usb_latency_timer_path (port_);
+  if (!path.empty ()) {
+    int latency_timer = read_sysfs_int (path);
+    if (!low_latency_applied_) {
+      saved_latency_timer_ = latency_timer;
+    }
+    if (write_sysfs_int (path, SERIAL_LOW_LATENCY_TIMER_MS)) {
+      latency_timer = SERIAL_LOW_LATENCY_TIMER_MS;
+    }
+    low_latency_status_.latency_timer_ms = latency_timer;
+  }
+#endif
+  low_latency_applied_ = true;
+}
+
+void
+Serial::SerialImpl::restoreLowLatency ()
+{
+  if (!low_latency_applied_) {
+    return;
+  }
+#if defined(__linux__)
+  struct serial_struct ser;
+  if (low_latency_status_.async_low_latency && !saved_async_low_latency_ &&
+      -1 != ioctl (fd_, TIOCGSERIAL, &ser)) {
+    ser.flags &= ~ASYNC_LOW_LATENCY;
+    ioctl (fd_, TIOCSSERIAL, &ser);
+  }
+  if (saved_latency_timer_ > 0) {
+    write_sysfs_int (usb_latency_timer_path (port_), saved_latency_timer_);
+  }
+#endif
+  low_latency_applied_ = false;
+  saved_latency_timer_ = -1;
+  low_latency_status_ = LowLatencyStatus ();
+}
+
+size_t
+Serial::SerialImpl::readLine (string &line, size_t size, const string &eol)
+{
+  // Without read-ahead nothing may be read past the delimiter, so every byte
+  // goes through the one byte read below. The chunked scan needs the
+  // read-ahead buffer to carry what follows the line into the next call.
+  size_t eol_len = eol.size ();
+  size_t read_so_far = 0;
+  while (read_so_far < size) {
+    if (rx_end_ == rx_begin_) {
+      // Nothing buffered, a one byte read waits with the usual timeouts and,
+      // with read-ahead enabled, refills the buffer with whatever else has
+      // arrived
+      uint8_t byte;
+      if (read (&byte, 1) == 0) {
+        break; // Timeout occured on reading 1 byte
+      }
+      line.push_back (static_cast<char> (byte));
+      read_so_far++;
+      // The line is only compared when its last byte could end the EOL
+      if (eol_len == 0 || (read_so_far >= eol_len &&
+          byte == static_cast<uint8_t> (eol[eol_len - 1]) &&
+          line.compare (line.size () - eol_len, eol_len, eol) == 0)) {
+        break; // EOL found
+      }
+      continue;
+    }
+    const uint8_t *chunk = &rx_buffer_[rx_begin_];
+    size_t count = std::min (rx_end_ - rx_begin_, size - read_so_far);
+    size_t take = count;
+    bool found = false;
+    if (eol_len == 0) {
+      take = 1;
+      found = true;
+    }
+    // Only the last EOL byte is searched for, the rest is checked on a hit
+    const uint8_t *scan = chunk;
+    const uint8_t *hit;
+    while (!found && (hit = static_cast<const uint8_t *> (
+              memchr (scan, eol[eol_len - 1], chunk + count - scan))) != NULL) {
+      size_t end = static_cast<size_t> (hit - chunk) + 1;
+      if (read_so_far + end >= eol_len) {
+        // The EOL may straddle what is already in line and this chunk
+        size_t in_chunk = std::min (end, eol_len);
+        size_t in_line = eol_len - in_chunk;
+        if (memcmp (hit + 1 - in_chunk, eol.data () + in_line, in_chunk) == 0
+            && line.compare (line.size () - in_line, in_line, eol, 0,
+                             in_line) == 0) {
+          take = end;
+          found = true;
+          break;
+        }
+      }
+      scan = hit + 1;
+    }
+    line.append (reinterpret_cast<const char *> (chunk), take);
+    {
+      RxLock lock (&rx_mutex);
+      rx_begin_ += take;
+      if (rx_begin_ == rx_end_) {
+        rx_begin_ = rx_end_ = 0;
+      }
+      rx_stats_.syscalls_saved++;
+    }
+    read_so_far += take;
+    if (found) {
+      break;
+    }
+  }
+  return read_so_far;
+}
+
 size_t
 Serial::SerialImpl::write (const uint8_t *data, size_t length)
 {
+  std::error_code ec;
+  size_t bytes_written = write (data, length, ec);
+  throwError (ec, "Serial::write", __LINE__);
+  return bytes_written;
+}
+
+size_t
+Serial::SerialImpl::write (const uint8_t *data, size_t length,
+                           std::error_code &ec)
+{
+  iovec iov;
+  iov.iov_base = const_cast<uint8_t *> (data);
+  iov.iov_len = length;
+  return writev (&iov, 1, ec);
+}
+
+size_t
+Serial::SerialImpl::writev (const iovec *iov, size_t count)
+{
+  std::error_code ec;
+  size_t bytes_written = writev (iov, count, ec);
+  throwError (ec, "Serial::writev", __LINE__);
+  return bytes_written;
+}
+
+size_t
+Serial::SerialImpl::writev (const iovec *iov, size_t count,
+                            std::error_code &ec)
+{
+  ec.clear ();
   if (is_open_ == false) {
-    throw PortNotOpenedException ("Serial::write");
+    ec = make_error_code (serial::errc::port_not_opened);
+    return 0;
   }
   fd_set writefds;
   size_t bytes_written = 0;
+  size_t length = 0;
+  for (size_t i = 0; i < count; i++) {
+    length += iov[i].iov_len;
+  }
+  // Next byte to write is iov[index] at offset
+  size_t index = 0;
+  size_t offset = 0;
 
   // Calculate total timeout in milliseconds t_c + (t_m * N)
   long total_timeout_ms = timeout_.write_timeout_constant;
@@ -627,6 +1086,7 @@ Serial::SerialImpl::write (const uint8_t *data, size_t length)
     // otherwise a timeout of 0 won't be allowed through
     if (!first_iteration && (timeout_remaining_ms <= 0)) {
       // Timed out
+      ec = make_error_code (std::errc::timed_out);
       break;
     }
     first_iteration = false;
@@ -647,48 +1107,57 @@ Serial::SerialImpl::write (const uint8_t *data, size_t length)
         continue;
       }
       // Otherwise there was some error
-      THROW (IOException, errno);
+      ec.assign (errno, std::system_category ());
+      break;
     }
     /** Timeout **/
     if (r == 0) {
+      ec = make_error_code (std::errc::timed_out);
       break;
     }
     /** Port ready to write **/
-    if (r > 0) {
-      // Make sure our file descriptor is in the ready to write list
-      if (FD_ISSET (fd_, &writefds)) {
-        // This will write some
-        ssize_t bytes_written_now =
-          ::write (fd_, data + bytes_written, length - bytes_written);
-        // write should always return some data as select reported it was
-        // ready to write when we get to this point.
-        if (bytes_written_now < 1) {
-          // Disconnected devices, at least on Linux, show the
-          // behavior that they are always ready to write immediately
-          // but writing returns nothing.
-          throw SerialException ("device reports readiness to write but "
-                                 "returned no data (device disconnected?)");
-        }
-        // Update bytes_written
-        bytes_written += static_cast<size_t> (bytes_written_now);
-        // If bytes_written == size then we have written everything we need to
-        if (bytes_written == length) {
-          break;
-        }
-        // If bytes_written < size then we have more to write
-        if (bytes_written < length) {
-          continue;
-        }
-        // If bytes_written > size then we have over written, which shouldn't happen
-        if (bytes_written > length) {
-          throw SerialException ("write over wrote, too many bytes where "
-                                 "written, this shouldn't happen, might be "
-                                 "a logical error!");
-        }
+    // This shouldn't happen, if r > 0 our fd has to be in the list!
+    if (!FD_ISSET (fd_, &writefds)) {
+      ec = make_error_code (serial::errc::internal_error);
+      break;
+    }
+    while (iov[index].iov_len == offset) {
+      index++;
+      offset = 0;
+    }
+    // This will write some, the rest of a part written in the middle or a
+    // lone part needs no gather
+    ssize_t bytes_written_now;
+    if (offset > 0 || index + 1 == count) {
+      bytes_written_now =
+        ::write (fd_, static_cast<const uint8_t *> (iov[index].iov_base) +
+                 offset, iov[index].iov_len - offset);
+    } else {
+      bytes_written_now = ::writev (fd_, iov + index,
+        static_cast<int> (std::min (count - index,
+                                    static_cast<size_t> (IOV_MAX))));
+    }
+    // write should always return some data as select reported it was
+    // ready to write when we get to this point.
+    if (bytes_written_now < 1) {
+      // Disconnected devices, at least on Linux, show the
+      // behavior that they are always ready to write immediately
+      // but writing returns nothing.
+      ec = make_error_code (serial::errc::device_disconnected);
+      break;
+    }
+    // Update bytes_written and step over the parts written
+    bytes_written += static_cast<size_t> (bytes_written_now);
+    size_t advance = static_cast<size_t> (bytes_written_now);
+    while (advance > 0) {
+      size_t left = iov[index].iov_len - offset;
+      if (advance < left) {
+        offset += advance;
+        break;
       }
-      // This shouldn't happen, if r > 0 our fd has to be in the list!
-      THROW (IOException, "select reports ready to write, but our fd isn't"
-                          " in the list, this shouldn't happen!");
+      advance -= left;
+      index++;
+      offset = 0;
     }
   }
   return bytes_written;
@@ -732,6 +1201,12 @@ Serial::SerialImpl::getBaudrate () const
   return baudrate_;
 }
 
+unsigned long
+Serial::SerialImpl::getActualBaudrate () const
+{
+  return is_open_ ? actual_baudrate_ : baudrate_;
+}
+
 void
 Serial::SerialImpl::setBytesize (serial::bytesize_t bytesize)
 {
@@ -803,6 +1278,10 @@ Serial::SerialImpl::flushInput ()
   if (is_open_ == false) {
     throw PortNotOpenedException ("Serial::flushInput");
   }
+  {
+    RxLock lock (&rx_mutex);
+    rx_begin_ = rx_end_ = 0;
+  }
   tcflush (fd_, TCIFLUSH);
 }
 
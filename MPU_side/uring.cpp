@@ -0,0 +1,541 @@
+#if defined(__linux__)
+
+#include <algorithm>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "serial/uring.h"
+#include "serial/unix.h"
+
+// Not in the uapi headers before 6.7
+#define SERIAL_IORING_OP_READ_MULTISHOT 49
+
+// Buffer group id of the provided buffer ring
+#define SERIAL_URING_BGID 0
+
+using serial::UringEngine;
+using serial::UringStats;
+using serial::Serial;
+using serial::IOException;
+using serial::PortNotOpenedException;
+using std::invalid_argument;
+
+static int
+uring_setup (unsigned entries, io_uring_params *params)
+{
+  return static_cast<int> (::syscall (__NR_io_uring_setup, entries, params));
+}
+
+static int
+uring_register (int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+  return static_cast<int> (
+    ::syscall (__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+static int
+uring_enter (int fd, unsigned to_submit, unsigned min_complete,
+             unsigned flags, const void *arg, size_t arg_size)
+{
+  return static_cast<int> (::syscall (__NR_io_uring_enter, fd, to_submit,
+                                      min_complete, flags, arg, arg_size));
+}
+
+template <typename T> static T *
+ring_field (void *ring, unsigned offset)
+{
+  return reinterpret_cast<T *> (static_cast<uint8_t *> (ring) + offset);
+}
+
+static uint64_t
+to_user_data (void *op)
+{
+  return static_cast<uint64_t> (reinterpret_cast<uintptr_t> (op));
+}
+
+bool
+UringEngine::supported ()
+{
+  io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  int fd = uring_setup (4, &params);
+  if (fd < 0) {
+    return false;
+  }
+  // poll timeouts are passed with IORING_ENTER_EXT_ARG (5.11)
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    ::close (fd);
+    return false;
+  }
+  // Provided buffer rings need 5.19, try registering a one entry ring
+  size_t page = static_cast<size_t> (::sysconf (_SC_PAGESIZE));
+  void *ring = ::mmap (NULL, page, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  bool ok = false;
+  if (ring != MAP_FAILED) {
+    io_uring_buf_reg reg;
+    memset (&reg, 0, sizeof (reg));
+    reg.ring_addr = to_user_data (ring);
+    reg.ring_entries = 1;
+    reg.bgid = SERIAL_URING_BGID;
+    ok = uring_register (fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+  }
+  ::close (fd);
+  if (ring != MAP_FAILED) {
+    ::munmap (ring, page);
+  }
+  return ok;
+}
+
+UringEngine::UringEngine (unsigned entries, size_t buffer_size,
+                          unsigned buffer_count)
+  : ring_fd_ (-1), sq_ring_ (MAP_FAILED), sq_ring_size_ (0), sq_head_ (NULL),
+    sq_tail_ (NULL), sq_mask_ (0), sq_entries_ (0), sq_array_ (NULL),
+    sqes_ (MAP_FAILED), sqes_size_ (0), to_submit_ (0),
+    cq_ring_ (MAP_FAILED), cq_ring_size_ (0), cq_head_ (NULL),
+    cq_tail_ (NULL), cq_mask_ (0), cqes_ (NULL), buf_ring_ (MAP_FAILED),
+    buf_ring_size_ (0), buffers_ (NULL), buffer_size_ (buffer_size),
+    buffer_count_ (buffer_count), buf_tail_ (0), multishot_ (false)
+{
+  if (buffer_size == 0 || buffer_count == 0 || buffer_count > 32768 ||
+      (buffer_count & (buffer_count - 1)) != 0) {
+    throw invalid_argument ("buffer_count must be a power of two up to 32768");
+  }
+
+  io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  params.flags = IORING_SETUP_CLAMP;
+  ring_fd_ = uring_setup (entries, &params);
+  if (ring_fd_ < 0) {
+    THROW (IOException, errno);
+  }
+  // Without EXT_ARG io_uring_enter has no timeout and poll could block
+  // forever, such kernels are turned away like in supported
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    teardown ();
+    THROW (IOException, ENOSYS);
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  cq_ring_size_ = params.cq_off.cqes +
+                  params.cq_entries * sizeof (io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max (sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = ::mmap (NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    int error = errno;
+    teardown ();
+    THROW (IOException, error);
+  }
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = ::mmap (NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd_,
+                       IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      int error = errno;
+      teardown ();
+      THROW (IOException, error);
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof (io_uring_sqe);
+  sqes_ = ::mmap (NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    int error = errno;
+    teardown ();
+    THROW (IOException, error);
+  }
+
+  sq_head_ = ring_field<unsigned> (sq_ring_, params.sq_off.head);
+  sq_tail_ = ring_field<unsigned> (sq_ring_, params.sq_off.tail);
+  sq_mask_ = *ring_field<unsigned> (sq_ring_, params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = ring_field<unsigned> (sq_ring_, params.sq_off.array);
+  cq_head_ = ring_field<unsigned> (cq_ring_, params.cq_off.head);
+  cq_tail_ = ring_field<unsigned> (cq_ring_, params.cq_off.tail);
+  cq_mask_ = *ring_field<unsigned> (cq_ring_, params.cq_off.ring_mask);
+  cqes_ = ring_field<void> (cq_ring_, params.cq_off.cqes);
+
+  // Read buffers: the ring of descriptors and the buffers in one mapping,
+  // descriptors first so the ring is page aligned
+  size_t descriptors = buffer_count * sizeof (io_uring_buf);
+  size_t page = static_cast<size_t> (::sysconf (_SC_PAGESIZE));
+  descriptors = (descriptors + page - 1) & ~(page - 1);
+  buf_ring_size_ = descriptors + buffer_count * buffer_size;
+  buf_ring_ = ::mmap (NULL, buf_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf_ring_ == MAP_FAILED) {
+    int error = errno;
+    teardown ();
+    THROW (IOException, error);
+  }
+  buffers_ = static_cast<uint8_t *> (buf_ring_) + descriptors;
+
+  io_uring_buf_reg reg;
+  memset (&reg, 0, sizeof (reg));
+  reg.ring_addr = to_user_data (buf_ring_);
+  reg.ring_entries = buffer_count;
+  reg.bgid = SERIAL_URING_BGID;
+  if (uring_register (ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    int error = errno;
+    teardown ();
+    THROW (IOException, error);
+  }
+  for (unsigned i = 0; i < buffer_count; i++) {
+    recycleBuffer (static_cast<unsigned short> (i));
+  }
+
+  // Multishot reads need 6.7, older kernels get one read per completion
+  std::vector<uint8_t> probe_mem (sizeof (io_uring_probe) +
+                                  256 * sizeof (io_uring_probe_op));
+  io_uring_probe *probe = reinterpret_cast<io_uring_probe *> (&probe_mem[0]);
+  if (uring_register (ring_fd_, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+      probe->last_op >= SERIAL_IORING_OP_READ_MULTISHOT) {
+    multishot_ = (probe->ops[SERIAL_IORING_OP_READ_MULTISHOT].flags &
+                  IO_URING_OP_SUPPORTED) != 0;
+  }
+}
+
+UringEngine::~UringEngine ()
+{
+  for (std::map<Serial *, Port *>::iterator it = ports_.begin ();
+       it != ports_.end (); ++it) {
+    restoreVmin (it->second);
+  }
+  // Closing the ring cancels everything still in the kernel, after that no
+  // completion refers to the ops and ports any more
+  teardown ();
+  for (std::set<Op *>::iterator it = writes_.begin (); it != writes_.end ();
+       ++it) {
+    delete *it;
+  }
+  for (std::map<Serial *, Port *>::iterator it = ports_.begin ();
+       it != ports_.end (); ++it) {
+    delete it->second;
+  }
+  for (std::set<Port *>::iterator it = removed_.begin ();
+       it != removed_.end (); ++it) {
+    delete *it;
+  }
+}
+
+void
+UringEngine::teardown ()
+{
+  if (ring_fd_ >= 0) {
+    ::close (ring_fd_);
+    ring_fd_ = -1;
+  }
+  if (buf_ring_ != MAP_FAILED) {
+    ::munmap (buf_ring_, buf_ring_size_);
+    buf_ring_ = MAP_FAILED;
+  }
+  if (sqes_ != MAP_FAILED) {
+    ::munmap (sqes_, sqes_size_);
+    sqes_ = MAP_FAILED;
+  }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    ::munmap (cq_ring_, cq_ring_size_);
+  }
+  cq_ring_ = MAP_FAILED;
+  if (sq_ring_ != MAP_FAILED) {
+    ::munmap (sq_ring_, sq_ring_size_);
+    sq_ring_ = MAP_FAILED;
+  }
+}
+
+void
+UringEngine::add (Serial &port, DataCallback on_data)
+{
+  int fd = port.pimpl_->getFd ();
+  if (fd == -1) {
+    throw PortNotOpenedException ("UringEngine::add");
+  }
+  remove (port);
+
+  // SerialImpl configures VMIN=0, which makes an empty tty read return 0
+  // rather than EAGAIN and so never lets io_uring wait for data
+  termios options;
+  if (::tcgetattr (fd, &options) == -1) {
+    THROW (IOException, errno);
+  }
+  cc_t vmin = options.c_cc[VMIN];
+  options.c_cc[VMIN] = 1;
+  if (::tcsetattr (fd, TCSANOW, &options) == -1) {
+    THROW (IOException, errno);
+  }
+
+  Port *entry = new Port;
+  entry->serial = &port;
+  entry->fd = fd;
+  entry->on_data = on_data;
+  entry->read_op.kind = Op::READ;
+  entry->read_op.port = entry;
+  entry->read_op.offset = 0;
+  entry->removed = false;
+  entry->inflight = 0;
+  entry->saved_vmin = vmin;
+  ports_[&port] = entry;
+  armRead (entry);
+}
+
+void
+UringEngine::remove (Serial &port)
+{
+  std::map<Serial *, Port *>::iterator it = ports_.find (&port);
+  if (it == ports_.end ()) {
+    return;
+  }
+  Port *entry = it->second;
+  ports_.erase (it);
+  entry->removed = true;
+  restoreVmin (entry);
+  if (entry->inflight == 0) {
+    delete entry;
+    return;
+  }
+  removed_.insert (entry);
+  // The read completes with -ECANCELED, the entry is freed once nothing
+  // of it is left in the kernel
+  io_uring_sqe *sqe = static_cast<io_uring_sqe *> (getSqe ());
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = to_user_data (&entry->read_op);
+  sqe->user_data = 0;
+}
+
+void
+UringEngine::write (Serial &port, const uint8_t *data, size_t length)
+{
+  std::map<Serial *, Port *>::iterator it = ports_.find (&port);
+  if (it == ports_.end ()) {
+    throw PortNotOpenedException ("UringEngine::write");
+  }
+  if (length == 0) {
+    return;
+  }
+  Op *op = new Op;
+  op->kind = Op::WRITE;
+  op->port = it->second;
+  op->data.assign (data, data + length);
+  op->offset = 0;
+  op->port->inflight++;
+  writes_.insert (op);
+  queueWrite (op);
+}
+
+size_t
+UringEngine::submit ()
+{
+  unsigned count = to_submit_;
+  if (count > 0 && enter (count, 0, 0) < 0) {
+    THROW (IOException, errno);
+  }
+  return count;
+}
+
+size_t
+UringEngine::poll (int timeout_ms)
+{
+  unsigned ready = *cq_tail_ - *cq_head_;
+  // Completions already posted are dispatched without waiting
+  if (ready > 0 || timeout_ms == 0) {
+    if (to_submit_ > 0 && enter (to_submit_, 0, 0) < 0) {
+      THROW (IOException, errno);
+    }
+  } else if (enter (to_submit_, 1, timeout_ms) < 0) {
+    if (errno != ETIME && errno != EINTR) {
+      THROW (IOException, errno);
+    }
+  }
+  return reap ();
+}
+
+bool
+UringEngine::multishot () const
+{
+  return multishot_;
+}
+
+UringStats
+UringEngine::getStats () const
+{
+  return stats_;
+}
+
+void *
+UringEngine::getSqe ()
+{
+  unsigned tail = *sq_tail_;
+  if (tail - __atomic_load_n (sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+    // Ring full, hand the batch over to make room
+    if (enter (to_submit_, 0, 0) < 0) {
+      THROW (IOException, errno);
+    }
+  }
+  unsigned index = tail & sq_mask_;
+  io_uring_sqe *sqe = static_cast<io_uring_sqe *> (sqes_) + index;
+  memset (sqe, 0, sizeof (*sqe));
+  sq_array_[index] = index;
+  __atomic_store_n (sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  to_submit_++;
+  return sqe;
+}
+
+void
+UringEngine::restoreVmin (Port *port)
+{
+  termios options;
+  if (::tcgetattr (port->fd, &options) == 0) {
+    options.c_cc[VMIN] = port->saved_vmin;
+    ::tcsetattr (port->fd, TCSANOW, &options);
+  }
+}
+
+void
+UringEngine::armRead (Port *port)
+{
+  io_uring_sqe *sqe = static_cast<io_uring_sqe *> (getSqe ());
+  sqe->opcode = multishot_ ? SERIAL_IORING_OP_READ_MULTISHOT : IORING_OP_READ;
+  sqe->fd = port->fd;
+  sqe->off = static_cast<uint64_t> (-1);
+  sqe->len = multishot_ ? 0 : static_cast<uint32_t> (buffer_size_);
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = SERIAL_URING_BGID;
+  sqe->user_data = to_user_data (&port->read_op);
+  port->inflight++;
+}
+
+void
+UringEngine::queueWrite (Op *op)
+{
+  io_uring_sqe *sqe = static_cast<io_uring_sqe *> (getSqe ());
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = op->port->fd;
+  sqe->off = static_cast<uint64_t> (-1);
+  sqe->addr = to_user_data (&op->data[op->offset]);
+  sqe->len = static_cast<uint32_t> (op->data.size () - op->offset);
+  sqe->user_data = to_user_data (op);
+}
+
+void
+UringEngine::recycleBuffer (unsigned short bid)
+{
+  // Not ring->bufs: in C++ the uapi flexible array member is wrapped in a
+  // struct that moves it off offset 0
+  io_uring_buf_ring *ring = static_cast<io_uring_buf_ring *> (buf_ring_);
+  io_uring_buf *buf = static_cast<io_uring_buf *> (buf_ring_) +
+                      (buf_tail_ & (buffer_count_ - 1));
+  buf->addr = to_user_data (buffers_ + bid * buffer_size_);
+  buf->len = static_cast<uint32_t> (buffer_size_);
+  buf->bid = bid;
+  buf_tail_++;
+  __atomic_store_n (&ring->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+int
+UringEngine::enter (unsigned to_submit, unsigned min_complete, int timeout_ms)
+{
+  unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  io_uring_getevents_arg arg;
+  __kernel_timespec ts;
+  const void *argp = NULL;
+  size_t arg_size = 0;
+  if (min_complete > 0 && timeout_ms > 0) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+    memset (&arg, 0, sizeof (arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = to_user_data (&ts);
+    flags |= IORING_ENTER_EXT_ARG;
+    argp = &arg;
+    arg_size = sizeof (arg);
+  }
+  stats_.enters++;
+  int r = uring_enter (ring_fd_, to_submit, min_complete, flags, argp,
+                       arg_size);
+  if (r >= 0) {
+    stats_.submissions += static_cast<unsigned> (r);
+    to_submit_ -= std::min (to_submit_, static_cast<unsigned> (r));
+  }
+  return r;
+}
+
+size_t
+UringEngine::reap ()
+{
+  size_t dispatched = 0;
+  unsigned head = *cq_head_;
+  while (head != __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE)) {
+    io_uring_cqe cqe = static_cast<io_uring_cqe *> (cqes_)[head & cq_mask_];
+    head++;
+    // Free the slot before running callbacks, they may submit more work
+    __atomic_store_n (cq_head_, head, __ATOMIC_RELEASE);
+    stats_.completions++;
+
+    Op *op = reinterpret_cast<Op *> (static_cast<uintptr_t> (cqe.user_data));
+    if (op == NULL) {
+      continue;                 // cancel request
+    }
+    Port *port = op->port;
+
+    if (op->kind == Op::READ) {
+      if (cqe.flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid =
+          static_cast<unsigned short> (cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe.res > 0) {
+          stats_.bytes_read += static_cast<unsigned> (cqe.res);
+          if (!port->removed) {
+            port->on_data (*port->serial, buffers_ + bid * buffer_size_,
+                           static_cast<size_t> (cqe.res));
+            dispatched++;
+          }
+        }
+        recycleBuffer (bid);
+      }
+      if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        port->inflight--;
+        // Out of buffers or single-shot: read again. 0 is a hang-up and
+        // other errors are final, the port stops being read.
+        if (!port->removed &&
+            (cqe.res > 0 || cqe.res == -ENOBUFS || cqe.res == -EAGAIN)) {
+          armRead (port);
+        }
+      }
+    } else {
+      if (cqe.res > 0) {
+        stats_.bytes_written += static_cast<unsigned> (cqe.res);
+        op->offset += static_cast<size_t> (cqe.res);
+      }
+      if ((cqe.res > 0 || cqe.res == -EAGAIN) &&
+          op->offset < op->data.size ()) {
+        queueWrite (op);        // short write, send the rest
+        continue;
+      }
+      if (op->offset < op->data.size ()) {
+        stats_.write_errors++;
+      }
+      port->inflight--;
+      writes_.erase (op);
+      delete op;
+    }
+    if (port->removed && port->inflight == 0) {
+      removed_.erase (port);
+      delete port;
+    }
+  }
+  return dispatched;
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,220 @@
+#include <cstring>
+#include "link/window.h"
+#include "link/cobs.h"
+#include "crc16/crc16.h"
+#include "crc16/crc32c.h"
+
+void tx_window_init(struct TxWindow *win, uint8_t size)
+{
+    win->base = 0;
+    win->next = 0;
+    win->size = (size == 0 || size > LINK_MAX_WINDOW) ? LINK_MAX_WINDOW : size;
+}
+
+bool tx_window_full(const struct TxWindow *win)
+{
+    return (uint8_t)(win->next - win->base) >= win->size;
+}
+
+uint8_t tx_window_push(struct TxWindow *win, uint8_t flags, const uint8_t *payload, uint8_t len)
+{
+    uint8_t seq = win->next;
+    struct TxSlot *slot = &win->slot[seq % LINK_MAX_WINDOW];
+
+    slot->flags = flags;
+    slot->len = len;
+    slot->sent = false;
+    slot->acked = false;
+    memcpy(slot->payload, payload, len);
+    win->next++;
+    return seq;
+}
+
+void tx_window_ack(struct TxWindow *win, uint8_t cum, uint8_t sack)
+{
+    uint8_t in_flight = win->next - win->base;
+    uint8_t i;
+
+    //an ACK older than the window acknowledges nothing cumulatively
+    if((uint8_t)(cum - win->base) <= in_flight)
+    {
+        for(i = 0; i < (uint8_t)(cum - win->base); i++)
+            win->slot[(uint8_t)(win->base + i) % LINK_MAX_WINDOW].acked = true;
+    }
+    for(i = 0; i < LINK_MAX_WINDOW; i++)
+    {
+        uint8_t seq = cum + 1 + i;
+        if((sack & (1 << i)) && (uint8_t)(seq - win->base) < in_flight)
+            win->slot[seq % LINK_MAX_WINDOW].acked = true;
+    }
+    while(win->base != win->next && win->slot[win->base % LINK_MAX_WINDOW].acked)
+        win->base++;
+}
+
+int16_t tx_window_due(const struct TxWindow *win, uint32_t now, uint32_t rto)
+{
+    uint8_t seq;
+
+    for(seq = win->base; seq != win->next; seq++)
+    {
+        const struct TxSlot *slot = &win->slot[seq % LINK_MAX_WINDOW];
+        if(!slot->acked && (!slot->sent || now - slot->sent_at >= rto))
+            return seq;
+    }
+    return -1;
+}
+
+void tx_window_sent(struct TxWindow *win, uint8_t seq, uint32_t now)
+{
+    win->slot[seq % LINK_MAX_WINDOW].sent = true;
+    win->slot[seq % LINK_MAX_WINDOW].sent_at = now;
+}
+
+void rx_window_init(struct RxWindow *win)
+{
+    uint8_t i;
+
+    win->base = 0;
+    for(i = 0; i < LINK_MAX_WINDOW; i++)
+        win->slot[i].valid = false;
+}
+
+bool rx_window_accept(struct RxWindow *win, uint8_t seq, uint8_t flags, const uint8_t *payload, uint8_t len)
+{
+    struct RxSlot *slot = &win->slot[seq % LINK_MAX_WINDOW];
+
+    if((uint8_t)(seq - win->base) >= LINK_MAX_WINDOW || slot->valid || len > LINK_MAX_PAYLOAD)
+        return false;
+    slot->valid = true;
+    slot->flags = flags;
+    slot->len = len;
+    memcpy(slot->payload, payload, len);
+    return true;
+}
+
+int16_t rx_window_deliver(struct RxWindow *win, uint8_t *payload, uint8_t *flags)
+{
+    struct RxSlot *slot = &win->slot[win->base % LINK_MAX_WINDOW];
+
+    if(!slot->valid)
+        return -1;
+    memcpy(payload, slot->payload, slot->len);
+    *flags = slot->flags;
+    slot->valid = false;
+    win->base++;
+    return slot->len;
+}
+
+void rx_window_ack_fields(const struct RxWindow *win, uint8_t *cum, uint8_t *sack)
+{
+    //frames received but not delivered yet are acknowledged too, the sender can forget them
+    uint8_t next = win->base;
+    uint8_t i;
+
+    while((uint8_t)(next - win->base) < LINK_MAX_WINDOW && win->slot[next % LINK_MAX_WINDOW].valid)
+        next++;
+    *cum = next;
+    *sack = 0;
+    for(i = 0; i < LINK_MAX_WINDOW; i++)
+    {
+        uint8_t seq = next + 1 + i;
+        if((uint8_t)(seq - win->base) < LINK_MAX_WINDOW && win->slot[seq % LINK_MAX_WINDOW].valid)
+            *sack |= (1 << i);
+    }
+}
+
+//Appends the CRC of frame[start] .. frame[len - 1], least significant byte first
+static uint8_t append_crc(uint8_t *frame, uint8_t start, uint8_t len, bool use_crc32c)
+{
+    if(use_crc32c)
+    {
+        uint32_t crc = crc32c(&frame[start], len - start);
+        frame[len++] = (crc & 0xFF);
+        frame[len++] = ((crc >> 8) & 0xFF);
+        frame[len++] = ((crc >> 16) & 0xFF);
+        frame[len++] = ((crc >> 24) & 0xFF);
+    }
+    else
+    {
+        uint16_t crc = crc16_ccitt(&frame[start], len - start);
+        frame[len++] = (crc & 0xFF);
+        frame[len++] = ((crc >> 8) & 0xFF);
+    }
+    return len;
+}
+
+uint8_t link_build_data(uint8_t *frame, uint8_t flags, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+    frame[0] = (flags & LINK_FLAG_CRC32C) ? LINK_DATA32 : LINK_DATA16;
+    frame[1] = seq;
+    memcpy(&frame[2], payload, len);
+    return append_crc(frame, 0, 2 + len, flags & LINK_FLAG_CRC32C);
+}
+
+uint8_t link_build_ack(uint8_t *frame, uint8_t cum, uint8_t sack)
+{
+    frame[0] = LINK_ACK;
+    frame[1] = cum;
+    frame[2] = sack;
+    return append_crc(frame, 0, 3, false);
+}
+
+uint8_t link_build_framed_data(uint8_t *frame, uint8_t flags, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+    frame[0] = LINK_SOF;
+    frame[1] = flags & ~LINK_FLAG_ACK;
+    frame[2] = seq;
+    frame[3] = len;
+    memcpy(&frame[LINK_HEADER_LEN], payload, len);
+    return append_crc(frame, 1, LINK_HEADER_LEN + len, frame[1] & LINK_FLAG_CRC32C);
+}
+
+uint8_t link_build_framed_ack(uint8_t *frame, uint8_t cum, uint8_t sack)
+{
+    frame[0] = LINK_SOF;
+    frame[1] = LINK_FLAG_ACK;
+    frame[2] = cum;
+    frame[3] = 1;
+    frame[4] = sack;
+    return append_crc(frame, 1, LINK_HEADER_LEN + 1, false);
+}
+
+uint8_t link_trailer_len(uint8_t flags)
+{
+    return (flags & LINK_FLAG_CRC32C) ? 4 : 2;
+}
+
+uint8_t link_framed_len(const uint8_t *header)
+{
+    if(header[3] > LINK_MAX_PAYLOAD)
+        return 0;
+    return LINK_HEADER_LEN + header[3] + link_trailer_len(header[1]);
+}
+
+bool link_check_framed(const uint8_t *frame, uint32_t crc)
+{
+    uint8_t len = LINK_HEADER_LEN + frame[3];
+
+    if(frame[1] & LINK_FLAG_CRC32C)
+        return validate_crc32c(&frame[len], crc);
+    return validate_crc(&frame[len], (uint16_t)crc);
+}
+
+uint8_t link_cobs_wrap(uint8_t *frame, uint8_t len)
+{
+    cobs_encode(frame, len);
+    frame[len] = LINK_COBS_DELIMITER;
+    return len + 1;
+}
+
+bool link_check_cobs(uint8_t *frame, uint8_t len)
+{
+    if(len < LINK_HEADER_LEN)
+        return false;
+    frame[0] = LINK_SOF;
+    if(link_framed_len(frame) != len)
+        return false;
+    if(frame[1] & LINK_FLAG_CRC32C)
+        return link_check_framed(frame, crc32c(&frame[1], LINK_HEADER_LEN + frame[3] - 1));
+    return link_check_framed(frame, crc16_ccitt(&frame[1], LINK_HEADER_LEN + frame[3] - 1));
+}
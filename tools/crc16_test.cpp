@@ -0,0 +1,124 @@
+/*
+ * Equivalence test for the host CRC16 kernels.
+ *
+ * Checks crc16_ccitt_slice8, crc16_ccitt_slice16, crc16_ccitt_fold and crc16_ccitt_bulk in
+ * MPU_side/crc16.cpp against a byte-wise reference on random buffers of every length up to
+ * a few fold blocks, at every start offset within 16 bytes. crc16_ccitt() itself takes a
+ * uint8_t length, so it is compared directly up to 255 bytes and serves as the reference
+ * beyond that by streaming through crc16_update(). crc16_ccitt_parallel is compared with
+ * crc16_ccitt_bulk on buffers around its per-thread minimum, for 1 to MAX_THREADS threads.
+ * Exits non-zero on the first mismatch.
+ *
+ * Build and run from the repository root:
+ *   g++ -O2 -std=c++11 -IMPU_side tools/crc16_test.cpp MPU_side/crc16.cpp -pthread -o crc16_test
+ *   ./crc16_test
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "crc16/crc16.h"
+
+#define MAX_LEN     (4 * 1024 + 64)
+#define MAX_OFFSET  16
+#define ROUNDS      4
+#define MAX_THREADS 8
+
+typedef uint16_t (*crc_fn)(const uint8_t *data, size_t len);
+
+struct Kernel
+{
+    const char *name;
+    crc_fn fn;
+};
+
+static const Kernel kernels[] =
+{
+    { "slice8",     crc16_ccitt_slice8 },
+    { "slice16",    crc16_ccitt_slice16 },
+    { "fold",       crc16_ccitt_fold },
+    { "bulk",       crc16_ccitt_bulk },
+};
+
+static uint16_t reference(const uint8_t *data, size_t len)
+{
+    if (len <= 255)
+        return crc16_ccitt(data, (uint8_t)len);
+
+    uint16_t crc = crc16_init();
+    for (size_t i = 0; i < len; i++)
+        crc = crc16_update(crc, data[i]);
+    return crc16_final(crc);
+}
+
+int main(void)
+{
+    std::vector<uint8_t> buffer(MAX_LEN + MAX_OFFSET);
+    size_t checks = 0;
+
+    srand(1);
+    for (size_t i = 0; i < buffer.size(); i++)
+        buffer[i] = (uint8_t)rand();
+
+    //the streaming reference itself must agree with crc16_ccitt where both apply
+    for (size_t len = 0; len <= 255; len++)
+    {
+        uint16_t crc = crc16_init();
+        for (size_t i = 0; i < len; i++)
+            crc = crc16_update(crc, buffer[i]);
+        if (crc16_final(crc) != crc16_ccitt(&buffer[0], (uint8_t)len))
+        {
+            printf("FAIL streaming: len %zu\n", len);
+            return 1;
+        }
+    }
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (size_t i = 0; i < buffer.size(); i++)
+            buffer[i] = (uint8_t)rand();
+
+        for (size_t offset = 0; offset < MAX_OFFSET; offset++)
+        {
+            for (size_t len = 0; len <= MAX_LEN; len++)
+            {
+                const uint8_t *data = &buffer[offset];
+                uint16_t expected = reference(data, len);
+                for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+                {
+                    uint16_t crc = kernels[k].fn(data, len);
+                    if (crc != expected)
+                    {
+                        printf("FAIL %s: len %zu offset %zu round %d: 0x%04X, expected 0x%04X\n",
+                               kernels[k].name, len, offset, round, crc, expected);
+                        return 1;
+                    }
+                    checks++;
+                }
+            }
+        }
+    }
+
+    //lengths between the multiples of the minimum chunk, with more and fewer threads than they allow
+    std::vector<uint8_t> large(5 * CRC16_PARALLEL_MIN_CHUNK + 7);
+    for (size_t i = 0; i < large.size(); i++)
+        large[i] = (uint8_t)rand();
+    for (size_t len = CRC16_PARALLEL_MIN_CHUNK - 1; len <= large.size(); len += CRC16_PARALLEL_MIN_CHUNK / 2)
+    {
+        uint16_t expected = crc16_ccitt_bulk(&large[0], len);
+        for (unsigned threads = 0; threads <= MAX_THREADS; threads++)
+        {
+            uint16_t crc = crc16_ccitt_parallel(&large[0], len, threads);
+            if (crc != expected)
+            {
+                printf("FAIL parallel: len %zu threads %u: 0x%04X, expected 0x%04X\n",
+                       len, threads, crc, expected);
+                return 1;
+            }
+            checks++;
+        }
+    }
+
+    printf("OK %zu checks\n", checks);
+    return 0;
+}
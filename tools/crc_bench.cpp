@@ -0,0 +1,145 @@
+/*
+ * Host micro-benchmark for every CRC path in the tree.
+ *
+ * Times the host kernels in MPU_side/crc16.cpp, the firmware MCU_side/crc16.c compiled for
+ * the host (with whichever CRC16_BACKEND it was built with) and the driverlib Crc16/Crc32
+ * on frame sizes from 1 B to 64 KiB. Each case runs warm (the same buffer over and over)
+ * and cold (walking a pool larger than the last-level cache so every frame misses).
+ *
+ * Build from the repository root:
+ *   gcc -O2 -std=c99 -IMCU_side -c MCU_side/crc16.c MCU_side/crc16_table.c MCU_side/driverlib/sw_crc.c
+ *   g++ -O2 -std=c++11 -IMPU_side tools/crc_bench.cpp MPU_side/crc16.cpp crc16.o crc16_table.o sw_crc.o -o crc_bench
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "crc16/crc16.h"
+
+//Firmware and driverlib entry points. The firmware's crc16.h is not included because its
+//streaming functions share names and signatures with the host ones.
+extern "C" {
+uint16_t crc16_ccitt(uint8_t *data, uint8_t len);
+uint16_t Crc16(uint16_t ui16Crc, const uint8_t *pui8Data, uint32_t ui32Count);
+uint32_t Crc32(uint32_t ui32Crc, const uint8_t *pui8Data, uint32_t ui32Count);
+}
+
+#define MAX_FRAME       (64 * 1024)
+#define COLD_POOL_SIZE  (256 * 1024 * 1024)
+#define MIN_RUN_NS      20000000.0
+
+typedef uint32_t (*crc_fn)(const uint8_t *data, size_t len);
+
+struct Kernel
+{
+    const char *name;
+    crc_fn fn;
+    size_t max_len;
+};
+
+static uint32_t host_bytewise(const uint8_t *data, size_t len)
+{
+    return crc16_ccitt(data, (uint8_t)len);
+}
+
+static uint32_t host_slice8(const uint8_t *data, size_t len)
+{
+    return crc16_ccitt_slice8(data, len);
+}
+
+static uint32_t host_slice16(const uint8_t *data, size_t len)
+{
+    return crc16_ccitt_slice16(data, len);
+}
+
+static uint32_t host_fold(const uint8_t *data, size_t len)
+{
+    return crc16_ccitt_fold(data, len);
+}
+
+static uint32_t host_bulk(const uint8_t *data, size_t len)
+{
+    return crc16_ccitt_bulk(data, len);
+}
+
+static uint32_t firmware_crc16(const uint8_t *data, size_t len)
+{
+    return crc16_ccitt(const_cast<uint8_t *>(data), (uint8_t)len);
+}
+
+static uint32_t driverlib_crc16(const uint8_t *data, size_t len)
+{
+    return Crc16(0, data, (uint32_t)len);
+}
+
+static uint32_t driverlib_crc32(const uint8_t *data, size_t len)
+{
+    return Crc32(0xFFFFFFFF, data, (uint32_t)len) ^ 0xFFFFFFFF;
+}
+
+static const Kernel kernels[] =
+{
+    { "host crc16_ccitt",   host_bytewise,   255 },
+    { "host slice8",        host_slice8,     MAX_FRAME },
+    { "host slice16",       host_slice16,    MAX_FRAME },
+    { "host fold",          host_fold,       MAX_FRAME },
+    { "host bulk",          host_bulk,       MAX_FRAME },
+    { "firmware crc16",     firmware_crc16,  255 },
+    { "driverlib Crc16",    driverlib_crc16, MAX_FRAME },
+    { "driverlib Crc32",    driverlib_crc32, MAX_FRAME },
+};
+
+//Runs fn over frames of len bytes taken from pool at the given stride until MIN_RUN_NS has
+//elapsed, and returns nanoseconds per byte.
+static double run(crc_fn fn, const uint8_t *pool, size_t pool_size, size_t len, size_t stride)
+{
+    typedef std::chrono::steady_clock clock;
+    volatile uint32_t sink = 0;
+    size_t offset = 0;
+    size_t bytes = 0;
+    double elapsed_ns = 0;
+    size_t batch = 1;
+
+    while (elapsed_ns < MIN_RUN_NS)
+    {
+        clock::time_point start = clock::now();
+        for (size_t i = 0; i < batch; i++)
+        {
+            sink = sink ^ fn(pool + offset, len);
+            offset += stride;
+            if (offset + len > pool_size)
+                offset = 0;
+        }
+        elapsed_ns += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        bytes += batch * len;
+        batch *= 2;
+    }
+    return elapsed_ns / bytes;
+}
+
+int main(void)
+{
+    std::vector<uint8_t> pool(COLD_POOL_SIZE);
+    for (size_t i = 0; i < pool.size(); i++)
+        pool[i] = (uint8_t)rand();
+
+    printf("%-18s %8s %12s %10s %12s %10s\n",
+           "kernel", "bytes", "warm ns/B", "warm GB/s", "cold ns/B", "cold GB/s");
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        for (size_t len = 1; len <= MAX_FRAME; len *= 2)
+        {
+            if (len > kernels[k].max_len)
+                break;
+            double warm = run(kernels[k].fn, &pool[0], len, len, 0);
+            //step past whole cache lines so consecutive frames never share one
+            size_t stride = (len + 63) & ~(size_t)63;
+            double cold = run(kernels[k].fn, &pool[0], pool.size(), len, stride);
+            printf("%-18s %8zu %12.3f %10.3f %12.3f %10.3f\n",
+                   kernels[k].name, len, warm, 1.0 / warm, cold, 1.0 / cold);
+        }
+    }
+    return 0;
+}
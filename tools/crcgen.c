@@ -0,0 +1,99 @@
+/*
+ * Host-side CRC table generator for the firmware.
+ *
+ * Emits a single C definition of a 256-entry CRC lookup table, built from the same
+ * (Width, Poly, RefIn) parameters as crc::CrcEngine in MPU_side/crc16/crc_engine.h.
+ * The firmware compiles the generated file once and declares the table extern, so
+ * no runtime table setup is needed and only one copy ends up in flash.
+ *
+ * Usage: crcgen NAME WIDTH POLY REFIN > NAME.c
+ *   NAME   C identifier of the table
+ *   WIDTH  8, 16 or 32
+ *   POLY   generator polynomial in normal (MSB-first) form, e.g. 0x1021
+ *   REFIN  0 for MSB-first tables, 1 for reflected (LSB-first) tables
+ *
+ * Example: crcgen crc16_table 16 0x1021 0 > crc16_table.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static uint32_t reflect(uint32_t value, unsigned bits)
+{
+    uint32_t result = 0;
+    unsigned i;
+    for (i = 0; i < bits; i++)
+    {
+        if (value & (1UL << i))
+            result |= 1UL << (bits - 1 - i);
+    }
+    return result;
+}
+
+static uint32_t table_entry(uint32_t index, unsigned width, uint32_t poly, int refin)
+{
+    uint32_t mask = (width == 32) ? 0xFFFFFFFFUL : ((1UL << width) - 1);
+    uint32_t crc;
+    int bit;
+
+    if (refin)
+    {
+        uint32_t rpoly = reflect(poly, width);
+        crc = index;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? ((crc >> 1) ^ rpoly) : (crc >> 1);
+    }
+    else
+    {
+        crc = index << (width - 8);
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & (1UL << (width - 1))) ? ((crc << 1) ^ poly) : (crc << 1);
+    }
+    return crc & mask;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name;
+    unsigned width;
+    uint32_t poly;
+    int refin;
+    int digits;
+    uint32_t index;
+
+    if (argc != 5)
+    {
+        fprintf(stderr, "usage: %s NAME WIDTH POLY REFIN\n", argv[0]);
+        return 1;
+    }
+
+    name = argv[1];
+    width = (unsigned)strtoul(argv[2], NULL, 0);
+    poly = (uint32_t)strtoul(argv[3], NULL, 0);
+    refin = atoi(argv[4]) != 0;
+
+    if (width != 8 && width != 16 && width != 32)
+    {
+        fprintf(stderr, "WIDTH must be 8, 16 or 32\n");
+        return 1;
+    }
+    digits = width / 4;
+
+    printf("//Generated by tools/crcgen: WIDTH=%u POLY=0x%0*lX REFIN=%d\n",
+           width, digits, (unsigned long)poly, refin);
+    printf("#include <stdint.h>\n\n");
+    printf("const uint%u_t %s[256] =\n{\n", width, name);
+    for (index = 0; index < 256; index++)
+    {
+        if (index % 8 == 0)
+            printf(" ");
+        printf("0x%0*lX", digits, (unsigned long)table_entry(index, width, poly, refin));
+        if (index != 255)
+            printf(",");
+        printf((index % 8 == 7) ? "\n" : " ");
+    }
+    printf("};\n");
+
+    return 0;
+}
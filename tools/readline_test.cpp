@@ -0,0 +1,107 @@
+/*
+ * System call test for Serial::readlines.
+ *
+ * Opens a pseudo-terminal, writes LINES CRLF-terminated lines of varying length to it and reads
+ * them back with readlines, once with read-ahead off (the default) and once with a read-ahead
+ * buffer. Both runs must return the same lines. Without read-ahead every byte costs one read(2);
+ * with it the chunked engine must get by with at most one system call per CHUNK_BYTES bytes, as
+ * counted by getReadAheadStats. Exits non-zero on the first failure.
+ *
+ * Build and run from the repository root:
+ *   g++ -O2 -std=c++11 -pthread -IMPU_side tools/readline_test.cpp MPU_side/serial.cpp
+ *       MPU_side/unix.cpp MPU_side/list_ports_linux.cpp MPU_side/termios2_linux.cpp -lutil
+ *       -o readline_test
+ *   ./readline_test
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <pty.h>
+#include <unistd.h>
+#include "serial/serial.h"
+
+#define LINES       64
+#define READ_AHEAD  256
+//Fewest bytes per system call the chunked engine has to reach, the pty hands over everything
+//that is queued in one read
+#define CHUNK_BYTES 16
+
+struct Run
+{
+    std::vector<std::string> lines;
+    serial::ReadAheadStats stats;
+};
+
+static Run read_lines(const std::string &text, size_t read_ahead)
+{
+    int master, slave;
+    char name[64];
+    if (openpty(&master, &slave, name, NULL, NULL) != 0)
+    {
+        perror("openpty");
+        exit(1);
+    }
+
+    //opened before anything is written, so the line discipline is raw by then
+    serial::Serial port(name, 115200, serial::Timeout::simpleTimeout(50));
+    port.setReadAhead(read_ahead);
+    if (write(master, text.data(), text.size()) != (ssize_t)text.size())
+    {
+        perror("write");
+        exit(1);
+    }
+
+    Run run;
+    run.lines = port.readlines(text.size() + 1, "\r\n");
+    run.stats = port.getReadAheadStats();
+    port.close();
+    close(slave);
+    close(master);
+    return run;
+}
+
+int main(void)
+{
+    std::string text;
+    std::vector<std::string> expected;
+
+    //a lone CR inside a line must not end it
+    for (int i = 0; i < LINES; i++)
+    {
+        std::string line = "line " + std::to_string(i) + std::string(i % 23, 'x');
+        if (i % 5 == 0)
+            line += "\rcr";
+        line += "\r\n";
+        expected.push_back(line);
+        text += line;
+    }
+
+    Run bytewise = read_lines(text, 0);
+    Run chunked = read_lines(text, READ_AHEAD);
+
+    if (bytewise.lines != expected || chunked.lines != expected)
+    {
+        printf("FAIL lines: %zu without read-ahead, %zu with it, %d expected\n",
+               bytewise.lines.size(), chunked.lines.size(), LINES);
+        return 1;
+    }
+    if (bytewise.stats.syscalls < text.size())
+    {
+        printf("FAIL expected a read per byte without read-ahead: %llu syscalls for %zu bytes\n",
+               (unsigned long long)bytewise.stats.syscalls, text.size());
+        return 1;
+    }
+    if (chunked.stats.syscalls * CHUNK_BYTES > text.size())
+    {
+        printf("FAIL chunked readlines: %llu syscalls for %zu bytes\n",
+               (unsigned long long)chunked.stats.syscalls, text.size());
+        return 1;
+    }
+
+    printf("OK %d lines, %zu bytes: %llu syscalls without read-ahead, %llu with it\n", LINES,
+           text.size(), (unsigned long long)bytewise.stats.syscalls,
+           (unsigned long long)chunked.stats.syscalls);
+    return 0;
+}
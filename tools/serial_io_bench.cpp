@@ -0,0 +1,260 @@
+/*
+ * Host benchmark of the two multi-port serial backends.
+ *
+ * Opens PORTS pseudo-terminals, forks a child that echoes everything written to them, and
+ * runs request/response rounds: one FRAME-byte frame is written to every port, then the
+ * echoes are collected from all ports. The same workload runs on
+ *   termios  serial::Reactor (epoll) with Serial::write and Serial::read, and
+ *   io_uring serial::UringEngine with batched writes and multishot reads.
+ * It reports system calls per second and per round, and CPU time (user + system of this
+ * process, the echo child excluded) per MB received.
+ *
+ * System calls of the termios backend are counted by interposing the libc wrappers it uses;
+ * the io_uring backend makes nothing but io_uring_enter after setup, which it counts itself.
+ *
+ * Build from the repository root:
+ *   g++ -O2 -std=c++11 -pthread -IMPU_side tools/serial_io_bench.cpp MPU_side/serial.cpp
+ *       MPU_side/unix.cpp MPU_side/list_ports_linux.cpp MPU_side/termios2_linux.cpp
+ *       MPU_side/reactor.cpp MPU_side/uring.cpp -lutil -ldl -o serial_io_bench
+ * Usage: serial_io_bench [PORTS [FRAME [ROUNDS]]]
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <dlfcn.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include "serial/serial.h"
+#include "serial/reactor.h"
+#include "serial/uring.h"
+
+static unsigned long syscall_count = 0;
+
+//Counting wrappers, found before libc's by the dynamic linker
+#define FORWARD(ret, name, params, args)                                    \
+    extern "C" ret name params                                              \
+    {                                                                       \
+        typedef ret (*fn_t) params;                                         \
+        static fn_t real = (fn_t)dlsym(RTLD_NEXT, #name);                   \
+        syscall_count++;                                                    \
+        return real args;                                                   \
+    }
+
+FORWARD(ssize_t, read, (int fd, void *buf, size_t count), (fd, buf, count))
+FORWARD(ssize_t, write, (int fd, const void *buf, size_t count), (fd, buf, count))
+FORWARD(int, pselect, (int n, fd_set *r, fd_set *w, fd_set *e, const struct timespec *t,
+                       const sigset_t *m), (n, r, w, e, t, m))
+FORWARD(int, epoll_wait, (int epfd, struct epoll_event *ev, int max, int timeout),
+        (epfd, ev, max, timeout))
+
+extern "C" int ioctl(int fd, unsigned long request, ...)
+{
+    typedef int (*fn_t)(int, unsigned long, void *);
+    static fn_t real = (fn_t)dlsym(RTLD_NEXT, "ioctl");
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    syscall_count++;
+    return real(fd, request, arg);
+}
+
+struct Result
+{
+    double seconds;
+    double cpu_seconds;
+    unsigned long syscalls;
+    size_t bytes;
+};
+
+static double cpu_now()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+//Echoes every master until the parent closes them
+static void echo_child(const std::vector<int> &masters)
+{
+    int ep = epoll_create1(0);
+    for (size_t i = 0; i < masters.size(); i++)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = masters[i];
+        epoll_ctl(ep, EPOLL_CTL_ADD, masters[i], &ev);
+    }
+    uint8_t buf[4096];
+    for (;;)
+    {
+        struct epoll_event events[64];
+        int n = epoll_wait(ep, events, 64, -1);
+        for (int i = 0; i < n; i++)
+        {
+            ssize_t got = read(events[i].data.fd, buf, sizeof(buf));
+            if (got <= 0)
+                _exit(0);
+            ssize_t done = 0;
+            while (done < got)
+            {
+                ssize_t w = write(events[i].data.fd, buf + done, got - done);
+                if (w <= 0)
+                    _exit(0);
+                done += w;
+            }
+        }
+    }
+}
+
+static Result run_termios(std::vector<serial::Serial *> &ports, size_t frame, size_t rounds)
+{
+    std::vector<uint8_t> out(frame, 0x55);
+    std::vector<size_t> pending(ports.size());
+    size_t outstanding = 0;
+    uint8_t buf[4096];
+    serial::Reactor reactor;
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        size_t *left = &pending[i];
+        reactor.add(*ports[i], [&outstanding, left, &buf](serial::Serial &port) {
+            size_t available;
+            while ((available = port.available()) > 0)
+            {
+                size_t n = port.read(buf, std::min(available, sizeof(buf)));
+                *left -= n;
+                outstanding -= n;
+            }
+        });
+    }
+
+    Result result;
+    unsigned long syscalls = syscall_count;
+    double cpu = cpu_now();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+    {
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+            ports[i]->write(&out[0], frame);
+            pending[i] += frame;
+            outstanding += frame;
+        }
+        while (outstanding > 0)
+            reactor.poll(1000);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.cpu_seconds = cpu_now() - cpu;
+    result.syscalls = syscall_count - syscalls;
+    result.bytes = rounds * ports.size() * frame;
+    return result;
+}
+
+static Result run_uring(std::vector<serial::Serial *> &ports, size_t frame, size_t rounds)
+{
+    std::vector<uint8_t> out(frame, 0x55);
+    size_t outstanding = 0;
+    serial::UringEngine engine(1024, 4096, 256);
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        engine.add(*ports[i], [&outstanding](serial::Serial &, const uint8_t *, size_t n) {
+            outstanding -= n;
+        });
+    }
+    engine.submit();
+
+    Result result;
+    serial::UringStats before = engine.getStats();
+    double cpu = cpu_now();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+    {
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+            engine.write(*ports[i], &out[0], frame);
+            outstanding += frame;
+        }
+        while (outstanding > 0)
+            engine.poll(1000);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.cpu_seconds = cpu_now() - cpu;
+    result.syscalls = engine.getStats().enters - before.enters;
+    result.bytes = rounds * ports.size() * frame;
+    for (size_t i = 0; i < ports.size(); i++)
+        engine.remove(*ports[i]);
+    //let the cancellations complete before the engine goes away
+    engine.poll(10);
+    return result;
+}
+
+static void report(const char *name, const Result &r, size_t rounds)
+{
+    double mb = r.bytes / 1e6;
+    printf("%-9s %10.0f %12.1f %12.3f %10.2f\n", name, r.syscalls / r.seconds,
+           (double)r.syscalls / rounds, r.cpu_seconds * 1e3 / mb, mb / r.seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t port_count = argc > 1 ? strtoul(argv[1], NULL, 0) : 16;
+    size_t frame = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+    size_t rounds = argc > 3 ? strtoul(argv[3], NULL, 0) : 20000;
+
+    std::vector<int> masters;
+    std::vector<serial::Serial *> ports;
+    for (size_t i = 0; i < port_count; i++)
+    {
+        int master, slave;
+        char name[64];
+        if (openpty(&master, &slave, name, NULL, NULL) == -1)
+        {
+            perror("openpty");
+            return 1;
+        }
+        struct termios options;
+        tcgetattr(master, &options);
+        cfmakeraw(&options);
+        tcsetattr(master, TCSANOW, &options);
+        masters.push_back(master);
+        ports.push_back(new serial::Serial(name, 115200, serial::Timeout::simpleTimeout(1000)));
+        close(slave);
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+        echo_child(masters);
+    for (size_t i = 0; i < masters.size(); i++)
+        close(masters[i]);
+
+    printf("%zu ports, %zu byte frames, %zu rounds\n", port_count, frame, rounds);
+    printf("%-9s %10s %12s %12s %10s\n", "backend", "syscalls/s", "syscalls/rnd", "CPU ms/MB",
+           "MB/s");
+    report("termios", run_termios(ports, frame, rounds), rounds);
+    if (serial::UringEngine::supported())
+        report("io_uring", run_uring(ports, frame, rounds), rounds);
+    else
+        printf("io_uring  not supported by this kernel\n");
+
+    for (size_t i = 0; i < ports.size(); i++)
+        delete ports[i];
+    kill(child, SIGTERM);
+    waitpid(child, NULL, 0);
+    return 0;
+}